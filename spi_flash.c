@@ -11,17 +11,241 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "pico/binary_info.h"
+#include "pico/mutex.h"
 #include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "hardware/clocks.h"
+#include "microwire.pio.h"
 #include <string.h>
+#include <stddef.h>
 
 #define EEPROM_CMD_READ   0b110  // Read command
 #define EEPROM_CMD_WRITE  0b101  // Write command
 #define EEPROM_CMD_ERASE  0b111  // Erase command
 #define EEPROM_CMD_WEN    0b10011  // Write Enable command
 #define EEPROM_CMD_WDS    0b10000  // Write Disable command
+#define EEPROM_CMD_ERAL   0b10010  // Erase All command
+#define EEPROM_CMD_WRAL   0b10001  // Write All command
+
+/**
+ * @brief Pre-aligned command frames (MSB first), shared by every path that talks to the part
+ * @details An instruction is SB + 2-bit opcode + address, 13 bits for the x16 AT93C86A (29 with data).
+ * \details READ and WRITE/WRAL are right-aligned so DO or the data follow the last address bit directly
+ * \details (leading zeros before SB are ignored). ERASE/EWEN/EWDS/ERAL are left-aligned in 16 bits.
+ * \details EWEN/EWDS/ERAL/WRAL carry A9..A8 in their 5-bit opcode, the rest of the address is don't care.
+ * \details Everything folds to a constant when the address is a constant.
+ */
+#define EEPROM_ADDR_BITS  10
+#define EEPROM_ADDR_MASK  ((1u << EEPROM_ADDR_BITS) - 1)
+
+#define EEPROM_INSTR_N(cmd, addr, ab)  (((uint32_t)(cmd) << (ab)) | ((addr) & ((1u << (ab)) - 1)))
+#define EEPROM_INSTR(cmd, addr)        EEPROM_INSTR_N(cmd, addr, EEPROM_ADDR_BITS)
+#define EEPROM_INSTR_SPECIAL(cmd)      ((uint32_t)(cmd) << (EEPROM_ADDR_BITS - 2))
+
+#define EEPROM_FRAME_READ(addr)        ((uint16_t)EEPROM_INSTR(EEPROM_CMD_READ, addr))
+#define EEPROM_FRAME_WRITE(addr, data) ((EEPROM_INSTR(EEPROM_CMD_WRITE, addr) << 16) | ((data) & 0xFFFF))
+#define EEPROM_FRAME_ERASE(addr)       ((uint16_t)(EEPROM_INSTR(EEPROM_CMD_ERASE, addr) << 3))
+#define EEPROM_FRAME_SPECIAL(cmd)      ((uint16_t)(EEPROM_INSTR_SPECIAL(cmd) << 3))
+
+#define EEPROM_FRAME16_BYTES(f)        { (uint8_t)((f) >> 8), (uint8_t)(f) }
+#define EEPROM_FRAME32_BYTES(f)        { (uint8_t)((f) >> 24), (uint8_t)((f) >> 16), (uint8_t)((f) >> 8), (uint8_t)(f) }
+
+// The encodings the driver has been verified against on hardware
+_Static_assert(EEPROM_FRAME_READ(0x3FF) == 0x1BFF, "READ frame");
+_Static_assert(EEPROM_FRAME_WRITE(0x001, 0xABCD) == 0x1401ABCD, "WRITE frame");
+_Static_assert(EEPROM_FRAME_ERASE(0x010) == 0xE080, "ERASE frame");
+_Static_assert(EEPROM_FRAME_SPECIAL(EEPROM_CMD_WEN) == (EEPROM_CMD_WEN << 11), "EWEN frame");
+_Static_assert(EEPROM_FRAME_WRITE(0x400, 0) == EEPROM_FRAME_WRITE(0x000, 0), "A10 and up wrap");
+
+static const uint8_t eeprom_frame_wen[2] = EEPROM_FRAME16_BYTES(EEPROM_FRAME_SPECIAL(EEPROM_CMD_WEN));
+static const uint8_t eeprom_frame_wds[2] = EEPROM_FRAME16_BYTES(EEPROM_FRAME_SPECIAL(EEPROM_CMD_WDS));
+static const uint8_t eeprom_frame_eral[2] = EEPROM_FRAME16_BYTES(EEPROM_FRAME_SPECIAL(EEPROM_CMD_ERAL));
+
+/**
+ * @brief Organisation of a 93C46..93C86 part, with its frame templates precomputed
+ * @details The word paths build frames as template | (addr & mask) << shift, so switching part at runtime
+ * \details (see eeprom_probe) costs nothing per access. EWEN/EWDS/ERAL frames do not depend on the part.
+ * \details The word-level driver is x16 only: x8 geometries are reported by the probe but not selected.
+ */
+typedef struct {
+    const char *name;
+    uint8_t  addr_bits;   // Address bits clocked after SB + opcode
+    uint8_t  word_bits;   // 16 (ORG high) or 8 (ORG low)
+    uint16_t words;
+    uint16_t addr_mask;
+    uint16_t read_base;
+    uint32_t write_base;
+    uint16_t erase_base;
+    uint8_t  erase_shift;
+    uint32_t wral_base;   // WRAL is right-aligned like WRITE: the data follows its last don't-care address bit
+} eeprom_geometry_t;
+
+#define EEPROM_GEOMETRY(name, ab, wb, n) { name, ab, wb, n, (n) - 1, \
+    (uint16_t)EEPROM_INSTR_N(EEPROM_CMD_READ, 0, ab), EEPROM_INSTR_N(EEPROM_CMD_WRITE, 0, ab) << 16, \
+    (uint16_t)(EEPROM_INSTR_N(EEPROM_CMD_ERASE, 0, ab) << (13 - (ab))), 13 - (ab), \
+    EEPROM_INSTR_N(EEPROM_CMD_WRAL, 0, (ab) - 2) << 16 }
+
+static const eeprom_geometry_t eeprom_geometries[] = {
+    EEPROM_GEOMETRY("93C46 x16", 6, 16, 64),
+    EEPROM_GEOMETRY("93C46 x8", 7, 8, 128),
+    EEPROM_GEOMETRY("93C56 x16", 8, 16, 128),
+    EEPROM_GEOMETRY("93C56 x8", 9, 8, 256),
+    EEPROM_GEOMETRY("93C66 x16", 8, 16, 256),
+    EEPROM_GEOMETRY("93C66 x8", 9, 8, 512),
+    EEPROM_GEOMETRY("93C76 x16", 10, 16, 512),
+    EEPROM_GEOMETRY("93C76 x8", 11, 8, 1024),
+    EEPROM_GEOMETRY("AT93C86A x16", 10, 16, 1024),
+    EEPROM_GEOMETRY("93C86 x8", 11, 8, 2048),
+};
+#define EEPROM_GEOMETRY_AT93C86A (&eeprom_geometries[8])
+
+static const eeprom_geometry_t *eeprom_geom = EEPROM_GEOMETRY_AT93C86A;
+
+static inline uint16_t eeprom_frame_read(uint16_t addr) {
+    return eeprom_geom->read_base | (addr & eeprom_geom->addr_mask);
+}
+static inline uint32_t eeprom_frame_write(uint16_t addr, uint16_t data) {
+    return eeprom_geom->write_base | ((uint32_t)(addr & eeprom_geom->addr_mask) << 16) | data;
+}
+static inline uint16_t eeprom_frame_erase(uint16_t addr) {
+    return eeprom_geom->erase_base | ((addr & eeprom_geom->addr_mask) << eeprom_geom->erase_shift);
+}
+static inline uint32_t eeprom_frame_wral(uint16_t data) {
+    return eeprom_geom->wral_base | data;
+}
+
+typedef struct {
+    uint8_t  cmd;   // 3-bit SB+opcode, or 5-bit for EWEN/EWDS/ERAL/WRAL
+    uint16_t addr;
+    uint16_t data;
+} eeprom_frame_t;
+
+/// @brief Inverse of the EEPROM_FRAME_* encoders, for debug output and cross-checking a captured frame
+static eeprom_frame_t eeprom_frame_decode(uint32_t frame) {
+    eeprom_frame_t f = {0};
+    if (!frame) return f;
+
+    int sb = 31 - __builtin_clz(frame);        // Position of the start bit
+    int lsb = sb - (EEPROM_ADDR_BITS + 2);     // Position of A0
+    uint32_t instr = (lsb >= 0) ? (frame >> lsb) : (frame << -lsb);
+
+    f.cmd = (instr >> EEPROM_ADDR_BITS) & 0x7;
+    if (f.cmd == 0b100) {
+        f.cmd = (instr >> (EEPROM_ADDR_BITS - 2)) & 0x1F;
+    } else {
+        f.addr = instr & EEPROM_ADDR_MASK;
+    }
+    if (lsb >= 16) {
+        f.data = frame & 0xFFFF;
+    }
+    return f;
+}
+
+#define EEPROM_DO_PIN     PICO_DEFAULT_SPI_RX_PIN // DO is sampled directly for READY/BUSY polling
+#define EEPROM_TWP_MAX_US 10000   // Maximum write cycle time (tWP) from the datasheet
+#define EEPROM_TDIS_NS    100     // Minimum DI setup time to the SK rising edge (tDIS) from the datasheet, 2.7 V
+
+#ifndef EEPROM_GANG_CS_PINS
+#define EEPROM_GANG_CS_PINS {PICO_DEFAULT_SPI_CSN_PIN, 20, 21, 22} // CS of every chip on the shared bus
+#endif
+
+#ifndef EEPROM_SPI1_SCK_PIN
+#define EEPROM_SPI1_SCK_PIN 10 // Second hardware SPI bus
+#define EEPROM_SPI1_TX_PIN  11
+#define EEPROM_SPI1_RX_PIN  12
+#endif
+#ifndef EEPROM_PIO_SCK_PIN
+#define EEPROM_PIO_SCK_PIN  2  // First PIO Microwire bus
+#define EEPROM_PIO_DI_PIN   3
+#define EEPROM_PIO_DO_PIN   4
+#endif
+#ifndef EEPROM_POOL_CS_PINS
+#define EEPROM_POOL_CS_PINS {PICO_DEFAULT_SPI_CSN_PIN, 13, 5} // One chip per engine: spi0, spi1, pio0
+#endif
+#ifndef EEPROM_POOL_REACH
+#define EEPROM_POOL_REACH {0b001, 0b010, 0b100} // Engines each chip's socket can be switched to (fixed wiring by default)
+#endif
 
 static uint8_t dump_flag = 0;
 
+#ifdef EEPROM_FAULT_INJECT
+/**
+ * @brief Faults injected into the driver so the retry/recovery paths can be exercised on real hardware
+ * @details Every field defaults to 0 (disabled). Counters are updated by the driver so a test can
+ * \details report how many faults were injected and how many were recovered.
+ */
+typedef struct {
+    uint16_t read_flip_mask;    // XORed into the result of every read_flip_every'th read
+    uint32_t read_flip_every;
+    bool     busy_stuck;        // READY/BUSY never reports READY, so ready polling times out
+    uint32_t program_extra_us;  // READY/BUSY reports busy until this long after every program instruction (slow part / low VCC)
+    uint32_t lost_write_every;  // Every Nth write is issued in the EWDS state, the part ignores it and stays write-disabled
+    uint32_t torn_after_words;  // eeprom_write_buf() stops after this many words (torn multi-word update)
+    uint16_t power_loss_mask;   // If set, the word in flight at the torn point is programmed as data ^ mask (power lost mid-cycle)
+
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t flips_injected;
+    uint32_t writes_lost;
+    uint32_t busy_timeouts;
+    uint32_t torn_updates;
+    uint32_t retries;           // Recoveries attempted by eeprom_write_verified()
+
+    absolute_time_t busy_until; // Set by the driver from program_extra_us
+} eeprom_fault_t;
+
+static eeprom_fault_t eeprom_faults = {0};
+
+/// @brief Called as each program instruction is shifted in, to start the injected slow cycle
+static inline void eeprom_fault_program(void) {
+    eeprom_faults.busy_until = make_timeout_time_us(eeprom_faults.program_extra_us);
+}
+
+/// @brief READY as sampled from DO, overridden by the READY/BUSY faults
+static inline bool eeprom_fault_ready(bool ready) {
+    if (eeprom_faults.busy_stuck) return false;
+    return ready && time_reached(eeprom_faults.busy_until);
+}
+
+/// @brief Count a WRITE and, every lost_write_every'th one, drop the part into EWDS so it ignores it
+static void eeprom_fault_write(spi_inst_t *spi, uint cs_pin);
+#else
+static inline void eeprom_fault_program(void) {}
+#endif
+
+#ifdef EEPROM_WEAR_TRACK
+#define EEPROM_WEAR_BLOCK_WORDS 16  // Words per counter: 64 counters for the AT93C86A, fewer for smaller parts
+#define EEPROM_WEAR_BLOCKS      ((EEPROM_ADDR_MASK + 1) / EEPROM_WEAR_BLOCK_WORDS) // Largest x16 part
+
+/**
+ * @brief Program cycles per block of the tracked part, counted in RAM (see eeprom_wear_load)
+ * @details Counting is a RAM increment; nothing is programmed until eeprom_wear_flush.
+ */
+static struct {
+    int cs_pin;                            // Part being tracked, -1 until eeprom_wear_load
+    uint32_t writes[EEPROM_WEAR_BLOCKS];
+    size_t blocks;                         // In use for the part's geometry at eeprom_wear_load
+    uint32_t since_flush;
+} eeprom_wear = { .cs_pin = -1 };
+
+static inline void eeprom_wear_note(uint cs_pin, uint16_t addr) {
+    if ((int)cs_pin != eeprom_wear.cs_pin) return;
+    eeprom_wear.writes[(addr & eeprom_geom->addr_mask) / EEPROM_WEAR_BLOCK_WORDS]++;
+    eeprom_wear.since_flush++;
+}
+
+/// @brief ERAL/WRAL: one program cycle for every cell
+static inline void eeprom_wear_note_all(uint cs_pin) {
+    if ((int)cs_pin != eeprom_wear.cs_pin) return;
+    for (size_t b = 0; b < eeprom_wear.blocks; b++) eeprom_wear.writes[b]++;
+    eeprom_wear.since_flush++;
+}
+#else
+static inline void eeprom_wear_note(uint cs_pin, uint16_t addr) {}
+static inline void eeprom_wear_note_all(uint cs_pin) {}
+#endif
+
 static inline void delay_250ns() {
     /// @note B-Series uses 133MHz clock rather than 125MHz, adjust accordingly
     // setting loop to 4 iterations yields 316ns @ 125MHz clock
@@ -51,44 +275,91 @@ static inline void cs_deselect(uint cs_pin) {
     delay_250ns();
 }
 
+/**
+ * @brief Poll READY/BUSY after a program or erase instruction
+ * @details Once CS is brought high again (after tCS) DO reads low while the part is busy and high once the
+ * \details self-timed cycle has finished. CS is left low on return, which also clears the status from DO.
+ * @param do_pin the GPIO the part's DO is wired to
+ * @return true if the part reported ready within timeout_us
+ */
+bool eeprom_wait_ready_pin(uint cs_pin, uint do_pin, uint32_t timeout_us) {
+    absolute_time_t deadline = make_timeout_time_us(timeout_us);
+    bool ready;
+
+    cs_deselect(cs_pin);
+    cs_select(cs_pin);
+    #ifdef EEPROM_FAULT_INJECT
+    while (!(ready = eeprom_fault_ready(gpio_get(do_pin))) && !time_reached(deadline)) {
+    #else
+    while (!(ready = gpio_get(do_pin)) && !time_reached(deadline)) {
+    #endif
+        tight_loop_contents();
+    }
+    cs_deselect(cs_pin);
+    #ifdef EEPROM_FAULT_INJECT
+    if (!ready) eeprom_faults.busy_timeouts++;
+    #endif
+    return ready;
+}
+
+/// @brief eeprom_wait_ready_pin on the default bus's DO
+bool eeprom_wait_ready(uint cs_pin, uint32_t timeout_us) {
+    return eeprom_wait_ready_pin(cs_pin, EEPROM_DO_PIN, timeout_us);
+}
+
 void eeprom_write_enable(spi_inst_t *spi, uint cs_pin) {
     cs_deselect(cs_pin);
     cs_select(cs_pin);
-    uint16_t cmd = EEPROM_CMD_WEN << 11; // Command is 5 bits, padded to 16 bits
-    uint8_t cmdbuf[2] = {cmd >> 8, cmd & 0xFF}; // Split 16-bit command into two bytes
-    spi_write_blocking(spi, cmdbuf, 2);         // Send the two bytes
+    spi_write_blocking(spi, eeprom_frame_wen, 2); // Command is 5 bits, padded to 16 bits
     cs_deselect(cs_pin);
 }
 void eeprom_write_disable(spi_inst_t *spi, uint cs_pin) {
     cs_deselect(cs_pin);
     cs_select(cs_pin);
-    uint16_t cmd = EEPROM_CMD_WDS << 11; // Command is 5 bits, padded to 16 bits
-    uint8_t cmdbuf[2] = {cmd >> 8, cmd & 0xFF}; // Split 16-bit command into two bytes
-    spi_write_blocking(spi, cmdbuf, 2);         // Send the two bytes
+    spi_write_blocking(spi, eeprom_frame_wds, 2); // Command is 5 bits, padded to 16 bits
     cs_deselect(cs_pin);
 }
 
+#ifdef EEPROM_FAULT_INJECT
+static void eeprom_fault_write(spi_inst_t *spi, uint cs_pin) {
+    eeprom_faults.writes++;
+    if (eeprom_faults.lost_write_every && (eeprom_faults.writes % eeprom_faults.lost_write_every) == 0) {
+        // The part silently ignores WRITE in the EWDS state, exactly like after a brown-out
+        eeprom_write_disable(spi, cs_pin);
+        eeprom_faults.writes_lost++;
+    }
+}
+#endif
+
 void eeprom_read(spi_inst_t *spi, uint cs_pin, uint16_t addr, uint16_t *data) {
     if (!dump_flag) {
         cs_deselect(cs_pin);
         cs_select(cs_pin);
     }
 
-    // Construct the read command: 3-bit command + 10-bit address
-    uint16_t cmd = (EEPROM_CMD_READ << 10) | (addr & 0x03FF);
-    uint8_t cmdbuf[2] = {cmd >> 8, cmd & 0xFF};
-    uint8_t databuf[3] = {0}; // 3 bytes to accommodate the dummy bit and 16 data bits
+    // Construct the read command (3-bit command + 10-bit address) followed by the 3 bytes of clocks
+    // for the dummy bit and 16 data bits, so the whole read is a single full-duplex transfer
+    uint16_t frame = eeprom_frame_read(addr);
+    uint8_t txbuf[5] = {frame >> 8, frame & 0xFF, 0, 0, 0};
+    uint8_t rxbuf[5];
 
-    // Send the read command
-    spi_write_blocking(spi, cmdbuf, 2);
-
-    // Read 17 bits (2 bytes + 1 extra bit for the dummy bit)
-    spi_read_blocking(spi, 0, databuf, 3);
+    // Send the read command and read 17 bits (2 bytes + 1 extra bit for the dummy bit) without
+    // draining the RX FIFO in between
+    spi_write_read_blocking(spi, txbuf, rxbuf, 5);
+    const uint8_t *databuf = rxbuf + 2; // Bytes received while the command was shifted out are discarded
 
     // Combine the 17 bits into a 16-bit value
     // Shift the first two bytes left by 1 to discard the dummy bit
     *data = ((uint16_t)(databuf[0] << 9)) | ((uint16_t)(databuf[1] << 1)) | ((databuf[2] >> 7) & 0x01);
 
+    #ifdef EEPROM_FAULT_INJECT
+    eeprom_faults.reads++;
+    if (eeprom_faults.read_flip_every && (eeprom_faults.reads % eeprom_faults.read_flip_every) == 0) {
+        *data ^= eeprom_faults.read_flip_mask;
+        eeprom_faults.flips_injected++;
+    }
+    #endif
+
     // Debug output (optional)
     #ifdef DEBUG
     if (!dump_flag) {
@@ -97,254 +368,2410 @@ void eeprom_read(spi_inst_t *spi, uint cs_pin, uint16_t addr, uint16_t *data) {
     }
     #endif
 
-    if (!dump_flag) {
-        cs_deselect(cs_pin);
-        cs_select(cs_pin); // Ensure repeatability
+    if (!dump_flag) {
+        cs_deselect(cs_pin);
+        cs_select(cs_pin); // Ensure repeatability
+    }
+}
+
+void eeprom_write(spi_inst_t *spi, uint cs_pin, uint16_t addr, uint16_t data) {
+    #ifdef EEPROM_FAULT_INJECT
+    eeprom_fault_write(spi, cs_pin);
+    #endif
+    cs_deselect(cs_pin);
+    // sleep_us(1);
+    cs_select(cs_pin);
+
+    // Combine the 3-bit command, 10-bit address, and 16-bit data into a 29-bit value
+    uint32_t cmd = eeprom_frame_write(addr, data);
+    eeprom_wear_note(cs_pin, addr);
+// #define DEBUG
+    // Debug: Print the cmd value
+    #ifdef DEBUG
+    eeprom_frame_t decoded = eeprom_frame_decode(cmd);
+    printf("cmd: 0x%08X (op %X addr 0x%03X data 0x%04X)\n", cmd, decoded.cmd, decoded.addr, decoded.data);
+    #endif
+    // Split the 32-bit cmd into 4 bytes for SPI transmission
+    uint8_t cmdbuf[4] = EEPROM_FRAME32_BYTES(cmd);
+
+    // Debug: Print the cmdbuf values
+    #ifdef DEBUG
+    printf("cmdbuf: %02X %02X %02X %02X\n", cmdbuf[0], cmdbuf[1], cmdbuf[2], cmdbuf[3]);
+    #endif
+
+    // Perform the SPI write operation
+    spi_write_blocking(spi, cmdbuf, 4);
+    eeprom_fault_program();
+    // sleep_ms(10); // Wait for the maximum write cycle time to complete
+    // sleep_ms(4); // Wait for the typical write cycle time to complete
+    sleep_ms(7); // Wait for between the typical and the maximum write cycle time to complete
+    cs_deselect(cs_pin);
+    cs_select(cs_pin); // for repeatability (so that the previous write does not affect the next write)
+}
+void eeprom_write_buf(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, const uint16_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        // Debug: Print the address and data being written
+        // printf("Writing to Addr: 0x%03X, Data: 0x%04X\n", start_addr + i, buf[i]);
+
+        #ifdef EEPROM_FAULT_INJECT
+        if (eeprom_faults.torn_after_words && i == eeprom_faults.torn_after_words) {
+            if (eeprom_faults.power_loss_mask) {
+                eeprom_write(spi, cs_pin, start_addr + i, buf[i] ^ eeprom_faults.power_loss_mask);
+            }
+            eeprom_faults.torn_updates++;
+            return;
+        }
+        #endif
+
+        // Write the data to the EEPROM
+        eeprom_write(spi, cs_pin, start_addr + i, buf[i]);
+        cs_select(cs_pin);
+        // Wait for the write cycle to complete
+        // sleep_ms(5); // Ensure write cycle time is met
+    }
+}
+
+void eeprom_erase(spi_inst_t *spi, uint cs_pin, uint16_t addr) {
+    cs_deselect(cs_pin);
+    // eeprom_write_enable(spi, cs_pin);
+    cs_select(cs_pin);
+    uint8_t cmdbuf[2] = EEPROM_FRAME16_BYTES(eeprom_frame_erase(addr)); // 3-bit command + 10-bit address + 3 dummy bits
+    eeprom_wear_note(cs_pin, addr);
+    spi_write_blocking(spi, cmdbuf, 2);
+    eeprom_fault_program();
+    cs_deselect(cs_pin);
+    // sleep_ms(7); // Wait for erase cycle to complete
+    sleep_ms(4); // wait for typical write time for the erase cycle to complete
+}
+
+/**
+ * @brief ERAL: set every word to 0xFFFF in a single program cycle
+ * @note ERAL and WRAL are only specified at VCC 4.5 V to 5.5 V.
+ * @return true if the cycle finished within tWP
+ */
+bool eeprom_erase_all(spi_inst_t *spi, uint cs_pin) {
+    cs_deselect(cs_pin);
+    cs_select(cs_pin);
+    spi_write_blocking(spi, eeprom_frame_eral, 2);
+    eeprom_fault_program();
+    cs_deselect(cs_pin);
+    eeprom_wear_note_all(cs_pin);
+    return eeprom_wait_ready(cs_pin, EEPROM_TWP_MAX_US);
+}
+
+/// @brief WRAL: program data into every word in a single program cycle (see eeprom_erase_all)
+bool eeprom_write_all(spi_inst_t *spi, uint cs_pin, uint16_t data) {
+    cs_deselect(cs_pin);
+    cs_select(cs_pin);
+    uint8_t cmdbuf[4] = EEPROM_FRAME32_BYTES(eeprom_frame_wral(data));
+    spi_write_blocking(spi, cmdbuf, 4);
+    eeprom_fault_program();
+    cs_deselect(cs_pin);
+    eeprom_wear_note_all(cs_pin);
+    return eeprom_wait_ready(cs_pin, EEPROM_TWP_MAX_US);
+}
+
+/**
+ * @brief Shift a WRITE instruction in and return without waiting for the self-timed program cycle
+ * @details CS is left low, so other chips sharing SK/DI/DO can be addressed while this one programs.
+ * \details Completion is checked with eeprom_is_ready() or eeprom_wait_ready().
+ */
+void eeprom_write_start(spi_inst_t *spi, uint cs_pin, uint16_t addr, uint16_t data) {
+    #ifdef EEPROM_FAULT_INJECT
+    eeprom_fault_write(spi, cs_pin);
+    #endif
+    cs_deselect(cs_pin);
+    cs_select(cs_pin);
+    uint8_t cmdbuf[4] = EEPROM_FRAME32_BYTES(eeprom_frame_write(addr, data));
+    spi_write_blocking(spi, cmdbuf, 4);
+    eeprom_fault_program();
+    cs_deselect(cs_pin);
+    eeprom_wear_note(cs_pin, addr);
+}
+
+/// @brief Single non-blocking READY/BUSY sample on do_pin (see eeprom_wait_ready_pin)
+bool eeprom_is_ready_pin(uint cs_pin, uint do_pin) {
+    cs_select(cs_pin);
+    bool ready = gpio_get(do_pin);
+    #ifdef EEPROM_FAULT_INJECT
+    ready = eeprom_fault_ready(ready);
+    #endif
+    cs_deselect(cs_pin);
+    return ready;
+}
+
+/// @brief eeprom_is_ready_pin on the default bus's DO
+bool eeprom_is_ready(uint cs_pin) {
+    return eeprom_is_ready_pin(cs_pin, EEPROM_DO_PIN);
+}
+
+#define EEPROM_GANG_MAX_CHIPS 16
+
+typedef enum {
+    EEPROM_SCHED_SEQUENTIAL, // Program each chip to completion before moving on to the next
+    EEPROM_SCHED_LOCKSTEP,   // Start the same word on every chip, then wait for all of them
+    EEPROM_SCHED_POLLED,     // Start a chip's next word as soon as that chip reports ready
+} eeprom_sched_t;
+
+/**
+ * @brief Program the same buffer into up to EEPROM_GANG_MAX_CHIPS chips sharing SK/DI/DO with one CS each
+ * @details The program cycle (~5 ms) dwarfs the ~15 us needed to shift a WRITE in at 2 MHz, so starting
+ * \details other chips while one is busy scales throughput almost linearly with chip count.
+ * \details POLLED tracks a busy timer per chip, so a slow part does not hold the others back.
+ * @return false if any chip failed to report ready within EEPROM_TWP_MAX_US
+ */
+bool eeprom_gang_write_buf(spi_inst_t *spi, const uint *cs_pins, size_t n_chips, uint16_t start_addr,
+                           const uint16_t *buf, size_t len, eeprom_sched_t sched) {
+    if (n_chips > EEPROM_GANG_MAX_CHIPS) return false;
+
+    // Only one chip may be selected at a time on the shared bus
+    for (size_t c = 0; c < n_chips; c++) {
+        cs_deselect(cs_pins[c]);
+    }
+
+    switch (sched) {
+    case EEPROM_SCHED_SEQUENTIAL:
+        for (size_t c = 0; c < n_chips; c++) {
+            for (size_t i = 0; i < len; i++) {
+                eeprom_write_start(spi, cs_pins[c], start_addr + i, buf[i]);
+                if (!eeprom_wait_ready(cs_pins[c], EEPROM_TWP_MAX_US)) return false;
+            }
+        }
+        return true;
+
+    case EEPROM_SCHED_LOCKSTEP:
+        for (size_t i = 0; i < len; i++) {
+            for (size_t c = 0; c < n_chips; c++) {
+                eeprom_write_start(spi, cs_pins[c], start_addr + i, buf[i]);
+            }
+            for (size_t c = 0; c < n_chips; c++) {
+                if (!eeprom_wait_ready(cs_pins[c], EEPROM_TWP_MAX_US)) return false;
+            }
+        }
+        return true;
+
+    case EEPROM_SCHED_POLLED: {
+        size_t next[EEPROM_GANG_MAX_CHIPS] = {0};
+        bool busy[EEPROM_GANG_MAX_CHIPS] = {false};
+        absolute_time_t started[EEPROM_GANG_MAX_CHIPS];
+        size_t finished = 0;
+
+        while (finished < n_chips) {
+            finished = 0;
+            for (size_t c = 0; c < n_chips; c++) {
+                if (busy[c]) {
+                    if (!eeprom_is_ready(cs_pins[c])) {
+                        if (absolute_time_diff_us(started[c], get_absolute_time()) > EEPROM_TWP_MAX_US) return false;
+                        continue;
+                    }
+                    busy[c] = false;
+                }
+                if (next[c] < len) {
+                    eeprom_write_start(spi, cs_pins[c], start_addr + next[c], buf[next[c]]);
+                    started[c] = get_absolute_time();
+                    busy[c] = true;
+                    next[c]++;
+                } else {
+                    finished++;
+                }
+            }
+        }
+        return true;
+    }
+    }
+    return false;
+}
+
+/* PROBE */
+typedef enum {
+    EEPROM_PROBE_ABSENT,    // DO never showed the dummy bit: empty socket
+    EEPROM_PROBE_FAULTY,    // DO stuck low (busy that never ends, short, wrong part)
+    EEPROM_PROBE_OK,
+    EEPROM_PROBE_AMBIGUOUS, // Address width known, but e.g. 93C56 vs 93C66 could not be told apart by reads alone
+} eeprom_probe_status_t;
+
+#define EEPROM_PROBE_MAX_ADDR_BITS 12
+
+/// @brief One bit-banged SK pulse: DI is latched on the rising edge, DO is valid tPD after it
+static inline void probe_clock(uint sck_pin) {
+    gpio_put(sck_pin, 1);
+    delay_500ns();
+    gpio_put(sck_pin, 0);
+    delay_500ns();
+}
+
+static void probe_shift_out(uint sck_pin, uint di_pin, uint32_t bits, uint n) {
+    while (n--) {
+        gpio_put(di_pin, (bits >> n) & 1);
+        probe_clock(sck_pin);
+    }
+    gpio_put(di_pin, 0);
+}
+
+static uint32_t probe_shift_in(uint sck_pin, uint do_pin, uint n) {
+    uint32_t v = 0;
+    while (n--) {
+        probe_clock(sck_pin);
+        v = (v << 1) | gpio_get(do_pin);
+    }
+    return v;
+}
+
+/// @brief Take SK/DI from the SPI for bit-banging; DO gets a pull-up so an empty socket reads all ones
+static void probe_pins_begin(uint sck_pin, uint di_pin, uint do_pin) {
+    gpio_set_function(sck_pin, GPIO_FUNC_SIO);
+    gpio_set_function(di_pin, GPIO_FUNC_SIO);
+    gpio_set_dir(sck_pin, GPIO_OUT);
+    gpio_set_dir(di_pin, GPIO_OUT);
+    gpio_put(sck_pin, 0);
+    gpio_put(di_pin, 0);
+    gpio_pull_up(do_pin);
+}
+
+static void probe_pins_end(uint sck_pin, uint di_pin, uint do_pin) {
+    gpio_disable_pulls(do_pin);
+    gpio_set_function(sck_pin, GPIO_FUNC_SPI);
+    gpio_set_function(di_pin, GPIO_FUNC_SPI);
+}
+
+/**
+ * @brief Bit-banged READ that counts address bits until DO drops to the dummy 0
+ * @return the number of address bits the part decoded, or 0 if no dummy bit appeared
+ */
+static uint probe_read(uint sck_pin, uint di_pin, uint do_pin, uint cs_pin, uint addr_bits, uint16_t addr, uint32_t *data) {
+    uint found = 0;
+
+    cs_deselect(cs_pin);
+    cs_select(cs_pin);
+    probe_shift_out(sck_pin, di_pin, EEPROM_CMD_READ, 3);
+    for (uint n = 1; n <= (addr_bits ? addr_bits : EEPROM_PROBE_MAX_ADDR_BITS); n++) {
+        probe_shift_out(sck_pin, di_pin, addr_bits ? (addr >> (addr_bits - n)) & 1 : 0, 1);
+        if (!gpio_get(do_pin)) {
+            found = n;
+            break;
+        }
+    }
+    if (found && data) {
+        // Odd address widths are the x8 organisation of the same die
+        *data = probe_shift_in(sck_pin, do_pin, (found & 1) ? 8 : 16);
+    }
+    cs_deselect(cs_pin);
+    return found;
+}
+
+/// @brief Bit-banged EWEN + WRITE + READY wait, only used by the optional reversible write test
+static bool probe_write(uint sck_pin, uint di_pin, uint do_pin, uint cs_pin, uint addr_bits, uint word_bits, uint16_t addr, uint32_t data) {
+    cs_deselect(cs_pin);
+    cs_select(cs_pin);
+    probe_shift_out(sck_pin, di_pin, (uint32_t)EEPROM_CMD_WEN << (addr_bits - 2), 3 + addr_bits);
+    cs_deselect(cs_pin);
+    cs_select(cs_pin);
+    probe_shift_out(sck_pin, di_pin, EEPROM_INSTR_N(EEPROM_CMD_WRITE, addr, addr_bits), 3 + addr_bits);
+    probe_shift_out(sck_pin, di_pin, data, word_bits);
+    return eeprom_wait_ready_pin(cs_pin, do_pin, EEPROM_TWP_MAX_US);
+}
+
+/**
+ * @brief Detect whether a part answers on cs_pin and what it is, in about a millisecond
+ * @details The address width is found by clocking READ address bits one at a time until the dummy 0
+ * \details appears on DO, which also gives x8 vs x16. Parts of the same width (93C56/66, 93C76/86) differ
+ * \details in whether the top address bit is decoded, so a few word pairs are compared for aliasing; if they
+ * \details all match and allow_write is set, one word is written through the alias and then restored.
+ * \details SK/DI are bit-banged as SIO for the duration and handed back to the SPI afterwards.
+ * \details On EEPROM_PROBE_OK with an x16 part the driver's geometry is switched to it.
+ */
+eeprom_probe_status_t eeprom_probe(uint sck_pin, uint di_pin, uint do_pin, uint cs_pin, bool allow_write,
+                                   const eeprom_geometry_t **geometry) {
+    eeprom_probe_status_t status = EEPROM_PROBE_OK;
+    const eeprom_geometry_t *g = NULL;
+    uint addr_bits;
+
+    probe_pins_begin(sck_pin, di_pin, do_pin);
+
+    // With CS high and no instruction DO is high-Z, or shows READY/BUSY if a cycle is still running
+    if (!eeprom_wait_ready_pin(cs_pin, do_pin, EEPROM_TWP_MAX_US)) {
+        status = EEPROM_PROBE_FAULTY;
+        goto out;
+    }
+
+    addr_bits = probe_read(sck_pin, di_pin, do_pin, cs_pin, 0, 0, NULL);
+    if (!addr_bits) {
+        status = EEPROM_PROBE_ABSENT;
+        goto out;
+    }
+
+    // Largest part with this address width first, then check whether the top address bit is real
+    for (int i = count_of(eeprom_geometries) - 1; i >= 0; i--) {
+        if (eeprom_geometries[i].addr_bits == addr_bits) {
+            g = &eeprom_geometries[i];
+            break;
+        }
+    }
+    if (!g) {
+        status = EEPROM_PROBE_FAULTY;
+        goto out;
+    }
+
+    const eeprom_geometry_t *smaller = NULL;
+    for (size_t i = 0; i < count_of(eeprom_geometries); i++) {
+        if (&eeprom_geometries[i] != g && eeprom_geometries[i].addr_bits == addr_bits) {
+            smaller = &eeprom_geometries[i];
+        }
+    }
+
+    if (smaller) {
+        uint16_t top = smaller->words; // First address bit the smaller part ignores
+        bool aliased = true;
+        uint32_t lo, hi;
+
+        for (uint16_t a = 0; a < 16 && aliased; a++) {
+            uint16_t addr = a * (smaller->words / 16);
+            probe_read(sck_pin, di_pin, do_pin, cs_pin, addr_bits, addr, &lo);
+            probe_read(sck_pin, di_pin, do_pin, cs_pin, addr_bits, addr | top, &hi);
+            aliased = (lo == hi);
+        }
+        if (aliased && allow_write) {
+            uint32_t mask = (1u << g->word_bits) - 1;
+            probe_read(sck_pin, di_pin, do_pin, cs_pin, addr_bits, 0, &lo);
+            probe_read(sck_pin, di_pin, do_pin, cs_pin, addr_bits, top, &hi);
+            probe_write(sck_pin, di_pin, do_pin, cs_pin, addr_bits, g->word_bits, top, ~lo & mask);
+            uint32_t check;
+            probe_read(sck_pin, di_pin, do_pin, cs_pin, addr_bits, 0, &check);
+            aliased = (check == (~lo & mask));
+            // Restore whichever physical word was written
+            probe_write(sck_pin, di_pin, do_pin, cs_pin, addr_bits, g->word_bits, aliased ? 0 : top, aliased ? lo : hi);
+            if (aliased) g = smaller;
+        } else if (aliased) {
+            status = EEPROM_PROBE_AMBIGUOUS;
+        }
+    }
+
+out:
+    probe_pins_end(sck_pin, di_pin, do_pin);
+
+    if (status == EEPROM_PROBE_OK && g->word_bits == 16) {
+        eeprom_geom = g;
+    }
+    if (geometry) *geometry = g;
+    return status;
+}
+
+/**
+ * @brief Socket map returned by eeprom_scan, bit n for cs_pins[n]
+ */
+typedef struct {
+    uint16_t populated;
+    uint16_t empty;
+    uint16_t faulty;
+} eeprom_scan_t;
+
+#define EEPROM_SCAN_BUSY_US 100 // A socket still busy after this is reported faulty rather than waited out
+
+/**
+ * @brief Classify up to EEPROM_GANG_MAX_CHIPS sockets sharing SK/DI/DO as populated, empty or faulty
+ * @details DO is shared and driven push-pull by every selected part, so only one socket is selected at a time:
+ * \details raising several CS lines while one part reports READY and another BUSY would short the two drivers.
+ * \details Each socket's READY/BUSY is sampled first (an empty socket leaves DO to the pull-up), then it gets
+ * \details SB + READ + addr_bits address bits and is deselected as soon as the dummy bit is seen, before any
+ * \details data is driven. With the driver's 10-bit geometry that is 14 SK periods per ready socket, well
+ * \details under a millisecond for a full gang.
+ * \details Populated: DO high up to the last address bit, then low. Empty: DO never leaves the pull-up within
+ * \details EEPROM_PROBE_MAX_ADDR_BITS address bits. Faulty: busy past EEPROM_SCAN_BUSY_US, or the dummy bit
+ * \details at any other place (a narrower or wider part, a short).
+ */
+eeprom_scan_t eeprom_scan(uint sck_pin, uint di_pin, uint do_pin, const uint *cs_pins, size_t n_sockets) {
+    eeprom_scan_t map = {0};
+    uint addr_bits = eeprom_geom->addr_bits;
+
+    if (n_sockets > EEPROM_GANG_MAX_CHIPS) n_sockets = EEPROM_GANG_MAX_CHIPS;
+
+    probe_pins_begin(sck_pin, di_pin, do_pin);
+
+    for (size_t c = 0; c < n_sockets; c++) {
+        uint cs_pin = cs_pins[c];
+        uint dummy_at = 0;
+
+        if (!eeprom_wait_ready_pin(cs_pin, do_pin, EEPROM_SCAN_BUSY_US)) {
+            map.faulty |= 1u << c;
+            continue;
+        }
+        cs_select(cs_pin);
+        probe_shift_out(sck_pin, di_pin, EEPROM_CMD_READ, 3);
+        // Clock as far as probe_read does, so a wider part shows its dummy bit late instead of looking empty
+        for (uint n = 1; n <= EEPROM_PROBE_MAX_ADDR_BITS; n++) {
+            probe_shift_out(sck_pin, di_pin, 0, 1);
+            if (!gpio_get(do_pin)) {
+                dummy_at = n;
+                break;
+            }
+        }
+        cs_deselect(cs_pin);
+
+        if (dummy_at == addr_bits) {
+            map.populated |= 1u << c;
+        } else if (dummy_at == 0) {
+            map.empty |= 1u << c;
+        } else {
+            map.faulty |= 1u << c;
+        }
+    }
+
+    probe_pins_end(sck_pin, di_pin, do_pin);
+    return map;
+}
+
+/**
+ * @brief Copy the CS pins of populated sockets into out, in socket order
+ * @return the number of pins written, ready to pass to eeprom_gang_write_buf
+ */
+size_t eeprom_scan_select(const eeprom_scan_t *map, const uint *cs_pins, size_t n_sockets, uint *out) {
+    size_t n = 0;
+    for (size_t c = 0; c < n_sockets && c < EEPROM_GANG_MAX_CHIPS; c++) {
+        if (map->populated & (1u << c)) out[n++] = cs_pins[c];
+    }
+    return n;
+}
+
+/* SHARED BUS */
+/// @brief A device on a shared SPI bus and the format it needs
+typedef struct {
+    uint cs_pin;
+    bool cs_active_high;  // The AT93C86A selects on CS high, most other SPI parts on CS low
+    uint baud;
+    uint data_bits;
+    spi_cpol_t cpol;
+    spi_cpha_t cpha;
+    uint do_pin;          // The instance's RX GPIO: a 93Cxx reports READY/BUSY on it, sampled directly
+} spi_device_t;
+
+/**
+ * @brief Serialises transactions from several drivers on one SPI instance
+ * @details The format last programmed into the PL022 is cached, so switching between devices only costs
+ * \details spi_set_baudrate()/spi_set_format() when their settings actually differ.
+ * @note Arbitration is cooperative: only the eeprom_bus_* entry points (and drivers calling spi_bus_acquire)
+ * \details take the lock. The plain eeprom_read/eeprom_write/eeprom_sequential_read_length/eeprom_read_bulk
+ * \details calls drive the instance directly and must not be used on a bus shared with another driver.
+ */
+typedef struct {
+    spi_inst_t *spi;
+    mutex_t lock;
+    const spi_device_t *owner;
+    uint baud;
+    uint data_bits;
+    spi_cpol_t cpol;
+    spi_cpha_t cpha;
+} spi_bus_t;
+
+void spi_bus_init(spi_bus_t *bus, spi_inst_t *spi) {
+    bus->spi = spi;
+    mutex_init(&bus->lock);
+    bus->owner = NULL;
+    // Nothing cached: no device asks for 0 baud or 0-bit frames, so the first acquire programs both
+    bus->baud = 0;
+    bus->data_bits = 0;
+    bus->cpol = SPI_CPOL_0;
+    bus->cpha = SPI_CPHA_0;
+}
+
+void spi_bus_add_device(const spi_device_t *dev) {
+    gpio_init(dev->cs_pin);
+    gpio_set_dir(dev->cs_pin, GPIO_OUT);
+    gpio_put(dev->cs_pin, !dev->cs_active_high);
+}
+
+/// @brief Take the bus for dev (blocking), reprogramming the PL022 only if dev needs a different format
+void spi_bus_acquire(spi_bus_t *bus, const spi_device_t *dev) {
+    mutex_enter_blocking(&bus->lock);
+    bus->owner = dev;
+    if (bus->baud != dev->baud) {
+        spi_set_baudrate(bus->spi, dev->baud);
+        bus->baud = dev->baud;
+    }
+    if (bus->data_bits != dev->data_bits || bus->cpol != dev->cpol || bus->cpha != dev->cpha) {
+        spi_set_format(bus->spi, dev->data_bits, dev->cpol, dev->cpha, SPI_MSB_FIRST);
+        bus->data_bits = dev->data_bits;
+        bus->cpol = dev->cpol;
+        bus->cpha = dev->cpha;
+    }
+}
+
+/**
+ * @brief Give the bus back
+ * @details The owner's CS is forced inactive: the EEPROM driver leaves CS high between calls, and a selected
+ * \details 93Cxx would decode the next device's traffic as instructions and drive DO into it.
+ */
+void spi_bus_release(spi_bus_t *bus) {
+    const spi_device_t *dev = bus->owner;
+    gpio_put(dev->cs_pin, !dev->cs_active_high);
+    bus->owner = NULL;
+    mutex_exit(&bus->lock);
+}
+
+/*
+Usage: static spi_device_t eeprom_dev = {PICO_DEFAULT_SPI_CSN_PIN, true, 1000 * 1000, 8, SPI_CPOL_0, SPI_CPHA_0, PICO_DEFAULT_SPI_RX_PIN};
+       static spi_device_t adc_dev = {9, false, 2000 * 1000, 16, SPI_CPOL_1, SPI_CPHA_1, PICO_DEFAULT_SPI_RX_PIN};
+       spi_bus_init(&bus, spi_default); spi_bus_add_device(&eeprom_dev); spi_bus_add_device(&adc_dev);
+       eeprom_bus_write_buf(&bus, &eeprom_dev, 0, save_buffer, 1024); // adc driver: spi_bus_acquire(&bus, &adc_dev) ...
+*/
+/**
+ * @brief Write a buffer to an EEPROM on a shared bus, releasing the bus for every program cycle
+ * @details The bus is held for ~15 us per word to shift the WRITE in, then for a single READY sample per poll,
+ * \details so another device (e.g. an ADC serviced from core1) keeps sampling at full rate during a paste.
+ * @return false if the part did not report ready within EEPROM_TWP_MAX_US
+ */
+bool eeprom_bus_write_buf(spi_bus_t *bus, const spi_device_t *dev, uint16_t start_addr, const uint16_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        spi_bus_acquire(bus, dev);
+        eeprom_write_start(bus->spi, dev->cs_pin, start_addr + i, buf[i]);
+        spi_bus_release(bus);
+
+        absolute_time_t deadline = make_timeout_time_us(EEPROM_TWP_MAX_US);
+        bool ready;
+        do {
+            sleep_us(250);
+            spi_bus_acquire(bus, dev);
+            ready = eeprom_is_ready_pin(dev->cs_pin, dev->do_pin);
+            spi_bus_release(bus);
+        } while (!ready && !time_reached(deadline));
+        if (!ready) return false;
+    }
+    return true;
+}
+
+/* BUS POOL */
+#define EEPROM_POOL_MAX_ENGINES 10 // spi0, spi1 and the 8 PIO state machines
+
+typedef enum {
+    EEPROM_ENGINE_SPI,
+    EEPROM_ENGINE_PIO,
+} eeprom_engine_type_t;
+
+/// @brief One independent bus (SK/DI/DO) driven by a PL022 or a PIO state machine running microwire.pio
+typedef struct {
+    eeprom_engine_type_t type;
+    spi_inst_t *spi;
+    PIO pio;
+    uint sm;
+    uint do_pin;     // Sampled directly for READY/BUSY
+    uint pending;    // Bytes pushed by eeprom_engine_shift_start() and not yet collected
+} eeprom_engine_t;
+
+typedef struct {
+    eeprom_engine_t engines[EEPROM_POOL_MAX_ENGINES];
+    size_t n_engines;
+} eeprom_pool_t;
+
+/// @brief A chip is bound to the engine its SK/DI/DO are wired to, and has its own CS
+typedef struct {
+    uint engine;
+    uint cs_pin;
+} eeprom_chip_t;
+
+static int microwire_offset[2] = {-1, -1}; // Program offset in pio0/pio1, loaded on first use
+
+/// @brief Add a hardware SPI bus to the pool, returns the engine index or -1 if the pool is full
+int eeprom_pool_add_spi(eeprom_pool_t *pool, spi_inst_t *spi, uint sck_pin, uint di_pin, uint do_pin, uint baud) {
+    if (pool->n_engines >= EEPROM_POOL_MAX_ENGINES) return -1;
+
+    spi_init(spi, baud);
+    spi_set_format(spi, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST); //< SPI Mode 0
+    gpio_set_function(do_pin, GPIO_FUNC_SPI);
+    gpio_set_function(sck_pin, GPIO_FUNC_SPI);
+    gpio_set_function(di_pin, GPIO_FUNC_SPI);
+
+    pool->engines[pool->n_engines] = (eeprom_engine_t){ .type = EEPROM_ENGINE_SPI, .spi = spi, .do_pin = do_pin };
+    return pool->n_engines++;
+}
+
+/// @brief Add a PIO state machine bus to the pool, returns the engine index or -1 if no SM is free
+int eeprom_pool_add_pio(eeprom_pool_t *pool, PIO pio, uint sck_pin, uint di_pin, uint do_pin, uint baud) {
+    if (pool->n_engines >= EEPROM_POOL_MAX_ENGINES) return -1;
+
+    int sm = pio_claim_unused_sm(pio, false);
+    if (sm < 0) return -1;
+
+    int *offset = &microwire_offset[pio_get_index(pio)];
+    if (*offset < 0) {
+        *offset = pio_add_program(pio, &microwire_program);
+    }
+    // 4 SM cycles per bit
+    microwire_program_init(pio, sm, *offset, sck_pin, di_pin, do_pin, (float)clock_get_hz(clk_sys) / (4.0f * baud));
+
+    pool->engines[pool->n_engines] = (eeprom_engine_t){ .type = EEPROM_ENGINE_PIO, .pio = pio, .sm = sm, .do_pin = do_pin };
+    return pool->n_engines++;
+}
+
+/**
+ * @brief Add a PIO bus that samples DO sample_sys_clks system clocks after the SK rising edge
+ * @details The PL022 samples on the rising edge, so clock-to-output plus cable delay has to fit in one bit
+ * \details time. Moving the sample later lets the bus run at the part's maximum SK over a long harness.
+ * \details Each engine gets its own copy of the program (at most MICROWIRE_SAMPLED_MAX_LEN instructions),
+ * \details assembled for its sample point. Resolution is one SM cycle, 1/MICROWIRE_CYCLES_PER_BIT of a bit.
+ * \details A sample late in the SK low phase delays the DI launch, so it is clamped to keep tDIS.
+ * @return the engine index, or -1 if the pool is full or the PIO has no free SM or instruction memory
+ */
+int eeprom_pool_add_pio_sampled(eeprom_pool_t *pool, PIO pio, uint sck_pin, uint di_pin, uint do_pin, uint baud,
+                                uint sample_sys_clks) {
+    uint16_t instr[MICROWIRE_SAMPLED_MAX_LEN];
+    float clkdiv = (float)clock_get_hz(clk_sys) / ((float)MICROWIRE_CYCLES_PER_BIT * baud);
+    uint sample = (uint)(sample_sys_clks / clkdiv + 0.5f);
+    // tDIS in SM cycles, rounded up; the SM runs at MICROWIRE_CYCLES_PER_BIT * baud
+    uint min_lead = (uint)(((uint64_t)EEPROM_TDIS_NS * MICROWIRE_CYCLES_PER_BIT * baud + 999999999u) / 1000000000u);
+    pio_program_t prog = { .instructions = instr, .origin = -1 };
+
+    if (pool->n_engines >= EEPROM_POOL_MAX_ENGINES) return -1;
+
+    prog.length = microwire_sampled_program_build(instr, sample, min_lead);
+    if (!pio_can_add_program(pio, &prog)) return -1;
+    int sm = pio_claim_unused_sm(pio, false);
+    if (sm < 0) return -1;
+
+    uint offset = pio_add_program(pio, &prog);
+    microwire_sampled_program_init(pio, sm, offset, prog.length, sck_pin, di_pin, do_pin, clkdiv);
+
+    pool->engines[pool->n_engines] = (eeprom_engine_t){ .type = EEPROM_ENGINE_PIO, .pio = pio, .sm = sm, .do_pin = do_pin };
+    return pool->n_engines++;
+}
+
+eeprom_chip_t eeprom_pool_add_chip(eeprom_pool_t *pool, uint engine, uint cs_pin) {
+    gpio_init(cs_pin);
+    gpio_set_dir(cs_pin, GPIO_OUT);
+    gpio_put(cs_pin, 0);
+    return (eeprom_chip_t){ .engine = engine, .cs_pin = cs_pin };
+}
+
+/// @brief Select the chip and queue up to 4 bytes on the engine's TX FIFO without waiting for them to shift out
+static void eeprom_engine_shift_start(eeprom_engine_t *e, uint cs_pin, const uint8_t *tx, size_t n) {
+    cs_deselect(cs_pin);
+    cs_select(cs_pin);
+    for (size_t i = 0; i < n; i++) {
+        if (e->type == EEPROM_ENGINE_SPI) {
+            while (!spi_is_writable(e->spi)) tight_loop_contents();
+            spi_get_hw(e->spi)->dr = tx[i];
+        } else {
+            pio_sm_put_blocking(e->pio, e->sm, (uint32_t)tx[i] << 24);
+        }
+    }
+    e->pending = n;
+}
+
+static bool eeprom_engine_shift_done(eeprom_engine_t *e) {
+    if (e->type == EEPROM_ENGINE_SPI) {
+        return !spi_is_busy(e->spi);
+    }
+    return pio_sm_get_rx_fifo_level(e->pio, e->sm) >= e->pending;
+}
+
+/// @brief Wait for the queued bytes, collect what was clocked in (rx may be NULL) and deselect the chip
+static void eeprom_engine_shift_finish(eeprom_engine_t *e, uint cs_pin, uint8_t *rx) {
+    for (size_t i = 0; i < e->pending; i++) {
+        uint8_t b;
+        if (e->type == EEPROM_ENGINE_SPI) {
+            while (!spi_is_readable(e->spi)) tight_loop_contents();
+            b = (uint8_t)spi_get_hw(e->spi)->dr;
+        } else {
+            b = (uint8_t)pio_sm_get_blocking(e->pio, e->sm);
+        }
+        if (rx) rx[i] = b;
+    }
+    e->pending = 0;
+    cs_deselect(cs_pin);
+}
+
+static bool eeprom_engine_is_ready(eeprom_engine_t *e, uint cs_pin) {
+    cs_select(cs_pin);
+    bool ready = gpio_get(e->do_pin);
+    cs_deselect(cs_pin);
+    return ready;
+}
+
+void eeprom_chip_write_enable(eeprom_pool_t *pool, eeprom_chip_t chip) {
+    eeprom_engine_t *e = &pool->engines[chip.engine];
+    eeprom_engine_shift_start(e, chip.cs_pin, eeprom_frame_wen, 2);
+    eeprom_engine_shift_finish(e, chip.cs_pin, NULL);
+}
+
+uint16_t eeprom_chip_read(eeprom_pool_t *pool, eeprom_chip_t chip, uint16_t addr) {
+    eeprom_engine_t *e = &pool->engines[chip.engine];
+    uint16_t frame = eeprom_frame_read(addr);
+    uint8_t tx[4] = {frame >> 8, frame & 0xFF, 0, 0};
+    uint8_t rx[4];
+    uint8_t last = 0;
+
+    // 5 bytes do not fit the 4-deep PIO FIFO in one go, so the final byte is a second shift under the same CS
+    eeprom_engine_shift_start(e, chip.cs_pin, tx, 4);
+    while (!eeprom_engine_shift_done(e)) tight_loop_contents();
+    for (size_t i = 0; i < 4; i++) {
+        rx[i] = (e->type == EEPROM_ENGINE_SPI) ? (uint8_t)spi_get_hw(e->spi)->dr : (uint8_t)pio_sm_get_blocking(e->pio, e->sm);
+    }
+    e->pending = 1;
+    if (e->type == EEPROM_ENGINE_SPI) {
+        spi_get_hw(e->spi)->dr = 0;
+    } else {
+        pio_sm_put_blocking(e->pio, e->sm, 0);
+    }
+    eeprom_engine_shift_finish(e, chip.cs_pin, &last);
+    return (uint16_t)((rx[2] << 9) | (rx[3] << 1) | (last >> 7));
+}
+
+/// @brief A programming job: len words from buf into one chip, progressed by eeprom_pool_run()/eeprom_pool_dispatch()
+typedef struct {
+    eeprom_chip_t chip;
+    uint16_t start_addr;
+    const uint16_t *buf;
+    size_t len;
+    bool diff;                // Read each word first and only program the ones that differ
+    uint32_t engine_mask;     // Engines whose bus reaches the chip, for work stealing (0 = chip.engine only)
+
+    size_t next;              // Words started (or skipped) so far
+    bool busy;                // Program cycle in progress
+    absolute_time_t started;
+} eeprom_job_t;
+
+/**
+ * @brief Advance a job on its engine, which must be idle
+ * @return true if a WRITE is now shifting; *timeout is set if the chip never came back from its last cycle
+ */
+static bool eeprom_job_step(eeprom_pool_t *pool, eeprom_job_t *job, bool *timeout) {
+    eeprom_engine_t *eng = &pool->engines[job->chip.engine];
+
+    if (job->busy) {
+        if (!eeprom_engine_is_ready(eng, job->chip.cs_pin)) {
+            *timeout = absolute_time_diff_us(job->started, get_absolute_time()) > EEPROM_TWP_MAX_US;
+            return false;
+        }
+        job->busy = false;
+    }
+    while (job->next < job->len) {
+        uint16_t addr = job->start_addr + job->next;
+        uint16_t data = job->buf[job->next];
+        if (job->diff && eeprom_chip_read(pool, job->chip, addr) == data) {
+            job->next++;
+            continue;
+        }
+        uint8_t tx[4] = EEPROM_FRAME32_BYTES(eeprom_frame_write(addr, data));
+        eeprom_engine_shift_start(eng, job->chip.cs_pin, tx, 4);
+        job->busy = true;
+        job->next++;
+        return true;
+    }
+    return false;
+}
+
+static inline bool eeprom_job_done(const eeprom_job_t *job) {
+    return job->next == job->len && !job->busy;
+}
+
+/**
+ * @brief true if a job other than `self` still has a program cycle running on cs_pin
+ * @details The part ignores instructions while it is busy, so a second job for the same chip must not shift
+ * \details a WRITE (or a diff READ, which would clock in status instead of data) until that cycle is over.
+ */
+static bool eeprom_chip_busy(const eeprom_job_t *jobs, size_t n_jobs, uint cs_pin, size_t self) {
+    for (size_t j = 0; j < n_jobs; j++) {
+        if (j != self && jobs[j].busy && jobs[j].chip.cs_pin == cs_pin) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Run programming jobs on every engine of the pool at once
+ * @details Each engine has at most one WRITE shifting at a time, but the shifts are queued on the FIFOs and
+ * \details clocked out by the hardware, so engines shift in parallel while the CPU services the others, and
+ * \details every chip's program cycle overlaps with everything else. A job only ever runs on its chip's engine.
+ * \details Several jobs may target the same chip; they take turns, one program cycle at a time.
+ * @return false if a chip did not report ready within EEPROM_TWP_MAX_US
+ */
+bool eeprom_pool_run(eeprom_pool_t *pool, eeprom_job_t *jobs, size_t n_jobs) {
+    int inflight[EEPROM_POOL_MAX_ENGINES];
+    size_t finished = 0;
+    bool timeout = false;
+
+    for (size_t e = 0; e < pool->n_engines; e++) inflight[e] = -1;
+    for (size_t j = 0; j < n_jobs; j++) {
+        jobs[j].next = 0;
+        jobs[j].busy = false;
+    }
+
+    while (finished < n_jobs) {
+        for (size_t e = 0; e < pool->n_engines; e++) {
+            eeprom_engine_t *eng = &pool->engines[e];
+
+            if (inflight[e] >= 0) {
+                if (!eeprom_engine_shift_done(eng)) continue;
+                // CS falling after D0 starts the self-timed program cycle
+                eeprom_engine_shift_finish(eng, jobs[inflight[e]].chip.cs_pin, NULL);
+                jobs[inflight[e]].started = get_absolute_time();
+                inflight[e] = -1;
+            }
+
+            for (size_t j = 0; j < n_jobs; j++) {
+                if (jobs[j].chip.engine != e) continue;
+                if (!jobs[j].busy && eeprom_chip_busy(jobs, n_jobs, jobs[j].chip.cs_pin, j)) continue;
+                if (eeprom_job_step(pool, &jobs[j], &timeout)) {
+                    inflight[e] = j;
+                    break;
+                }
+                if (timeout) return false;
+            }
+        }
+
+        finished = 0;
+        for (size_t j = 0; j < n_jobs; j++) {
+            finished += eeprom_job_done(&jobs[j]);
+        }
+    }
+    return true;
+}
+
+#define EEPROM_QUEUE_DEPTH  32 // Jobs queued per engine
+#define EEPROM_ENGINE_SLOTS 4  // Jobs an engine interleaves at once, so their program cycles overlap
+
+/// @brief Per-engine job queue: the owner pops from the head, thieves take from the tail
+typedef struct {
+    uint16_t jobs[EEPROM_QUEUE_DEPTH];
+    size_t head;
+    size_t tail;
+} eeprom_queue_t;
+
+/// @brief true if a job for cs_pin holds a slot on any engine, including the one asking
+static bool eeprom_chip_active(int active[][EEPROM_ENGINE_SLOTS], size_t n_engines, const eeprom_job_t *jobs,
+                               uint cs_pin) {
+    for (size_t e = 0; e < n_engines; e++) {
+        for (size_t k = 0; k < EEPROM_ENGINE_SLOTS; k++) {
+            if (active[e][k] >= 0 && jobs[active[e][k]].chip.cs_pin == cs_pin) return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Take the tail job of the fullest queue that engine `thief` can reach, or -1
+ * @details Only jobs whose engine_mask includes the thief move: a chip is never driven from an engine
+ * \details that is not wired to it, nor from two engines at once.
+ */
+static int eeprom_queue_steal(eeprom_queue_t *queues, size_t n_engines, eeprom_job_t *jobs,
+                              int active[][EEPROM_ENGINE_SLOTS], uint thief) {
+    int victim = -1;
+    size_t most = 0;
+
+    for (size_t v = 0; v < n_engines; v++) {
+        size_t depth = queues[v].tail - queues[v].head;
+        if (v == thief || depth <= most) continue;
+
+        const eeprom_job_t *cand = &jobs[queues[v].jobs[(queues[v].tail - 1) % EEPROM_QUEUE_DEPTH]];
+        if (!(cand->engine_mask & (1u << thief))) continue;
+
+        if (eeprom_chip_active(active, n_engines, jobs, cand->chip.cs_pin)) continue;
+
+        victim = v;
+        most = depth;
+    }
+    if (victim < 0) return -1;
+
+    int j = queues[victim].jobs[--queues[victim].tail % EEPROM_QUEUE_DEPTH];
+    jobs[j].chip.engine = thief;
+    return j;
+}
+
+/**
+ * @brief Run a heterogeneous batch of jobs with a queue per engine and optional work stealing
+ * @details Jobs start on their chip's engine. Each engine interleaves up to EEPROM_ENGINE_SLOTS jobs; once
+ * \details its own queue is empty it steals from the busiest neighbour that can reach the stolen chip, so
+ * \details engines whose chips only needed a few diffed words do not sit idle while another has a backlog.
+ * \details A chip holds at most one slot across all engines, so a second job for it waits at the queue head
+ * \details instead of shifting a WRITE into a part that is still programming.
+ * @param engine_done_us if not NULL, receives each engine's completion time relative to the start
+ * @return false if a chip timed out or a queue overflowed
+ */
+bool eeprom_pool_dispatch(eeprom_pool_t *pool, eeprom_job_t *jobs, size_t n_jobs, bool steal, uint64_t *engine_done_us) {
+    eeprom_queue_t queues[EEPROM_POOL_MAX_ENGINES] = {0};
+    int active[EEPROM_POOL_MAX_ENGINES][EEPROM_ENGINE_SLOTS];
+    int inflight[EEPROM_POOL_MAX_ENGINES];
+    uint64_t t0 = time_us_64();
+    size_t finished = 0;
+    bool timeout = false;
+
+    for (size_t e = 0; e < pool->n_engines; e++) {
+        inflight[e] = -1;
+        for (size_t k = 0; k < EEPROM_ENGINE_SLOTS; k++) active[e][k] = -1;
+        if (engine_done_us) engine_done_us[e] = 0;
+    }
+    for (size_t j = 0; j < n_jobs; j++) {
+        eeprom_queue_t *q = &queues[jobs[j].chip.engine];
+        if (q->tail - q->head >= EEPROM_QUEUE_DEPTH) return false;
+        q->jobs[q->tail++ % EEPROM_QUEUE_DEPTH] = j;
+        jobs[j].next = 0;
+        jobs[j].busy = false;
+        if (!jobs[j].engine_mask) jobs[j].engine_mask = 1u << jobs[j].chip.engine;
+    }
+
+    while (finished < n_jobs) {
+        for (size_t e = 0; e < pool->n_engines; e++) {
+            eeprom_engine_t *eng = &pool->engines[e];
+            bool idle = true;
+
+            if (inflight[e] >= 0) {
+                if (!eeprom_engine_shift_done(eng)) continue;
+                eeprom_engine_shift_finish(eng, jobs[inflight[e]].chip.cs_pin, NULL);
+                jobs[inflight[e]].started = get_absolute_time();
+                inflight[e] = -1;
+            }
+
+            for (size_t k = 0; k < EEPROM_ENGINE_SLOTS; k++) {
+                if (active[e][k] >= 0 && eeprom_job_done(&jobs[active[e][k]])) {
+                    active[e][k] = -1;
+                    finished++;
+                }
+                if (active[e][k] < 0) {
+                    if (queues[e].head != queues[e].tail) {
+                        int j = queues[e].jobs[queues[e].head % EEPROM_QUEUE_DEPTH];
+                        // One slot per chip: wait for the job already driving it, here or on a thief, to finish
+                        if (!eeprom_chip_active(active, pool->n_engines, jobs, jobs[j].chip.cs_pin)) {
+                            active[e][k] = j;
+                            queues[e].head++;
+                        }
+                    } else if (steal) {
+                        active[e][k] = eeprom_queue_steal(queues, pool->n_engines, jobs, active, e);
+                    }
+                }
+                if (active[e][k] < 0) continue;
+                idle = false;
+
+                if (inflight[e] < 0 && !eeprom_chip_busy(jobs, n_jobs, jobs[active[e][k]].chip.cs_pin, active[e][k]) &&
+                    eeprom_job_step(pool, &jobs[active[e][k]], &timeout)) {
+                    inflight[e] = active[e][k];
+                }
+                if (timeout) return false;
+            }
+
+            if (queues[e].head != queues[e].tail) idle = false;
+            if (idle && engine_done_us && !engine_done_us[e]) {
+                engine_done_us[e] = time_us_64() - t0;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Write a word and read it back, retrying up to `retries` more times on a mismatch
+ * @details A mismatch is most often a write issued while the part was in the EWDS state (e.g. after a brown-out),
+ * \details so EWEN is re-issued before every retry. The program cycle is ended by ready polling, and a part
+ * \details still busy after tWP is retried the same way, so a stuck READY/BUSY ends in false rather than a hang.
+ * @return true once the word reads back correctly
+ */
+bool eeprom_write_verified(spi_inst_t *spi, uint cs_pin, uint16_t addr, uint16_t data, uint retries) {
+    uint16_t readback;
+
+    for (uint attempt = 0; attempt <= retries; attempt++) {
+        if (attempt) {
+            eeprom_write_enable(spi, cs_pin);
+            #ifdef EEPROM_FAULT_INJECT
+            eeprom_faults.retries++;
+            #endif
+        }
+        eeprom_write_start(spi, cs_pin, addr, data);
+        if (!eeprom_wait_ready(cs_pin, EEPROM_TWP_MAX_US)) continue;
+        eeprom_read(spi, cs_pin, addr, &readback);
+        if (readback == data) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void eeprom_dump(spi_inst_t *spi, uint cs_pin) {
+    uint16_t data;
+    dump_flag = 1; // Set the dump flag to avoid redundant CS toggling in eeprom_read
+    printf("\nEEPROM Memory Dump:\n");
+    printf("Addr  | Data\n");
+    printf("------+-------\n");
+
+    for (uint16_t addr = 0; addr <= 0x03FF; addr++) {
+        //! Handle chip select here since dump_flag is active
+        cs_deselect(cs_pin);
+        cs_select(cs_pin);
+        // Use eeprom_read to read data from the EEPROM
+        eeprom_read(spi, cs_pin, addr, &data);
+
+        // Print the data in a formatted manner
+        if (addr % 16 == 0) {
+            printf("\n%04X  | ", addr);
+        }
+        printf("%04X ", data);
+    }
+
+    printf("\n");
+    dump_flag = 0; // Reset the dump flag
+}
+void eeprom_read_bulk(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, uint16_t *buf, size_t length);
+int eeprom_update_buf(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, const uint16_t *buf, size_t len);
+
+void eeprom_copy(spi_inst_t *spi, uint cs_pin, uint16_t* eeprom_buffer) {
+    // One sequential READ DMA'd straight into the caller's buffer instead of a single-word READ per word
+    eeprom_read_bulk(spi, cs_pin, 0x000, eeprom_buffer, eeprom_geom->words);
+    printf("EEPROM Memory Saved to buffer\r\n");
+}
+
+void eeprom_paste(spi_inst_t *spi, uint cs_pin, const uint16_t* eeprom_buffer) {
+    #ifdef EEPROM_LOW_MEM
+    // Diff-paste a chunk at a time: only words that differ are programmed
+    eeprom_update_buf(spi, cs_pin, 0x000, eeprom_buffer, eeprom_geom->words);
+    #else
+    for (uint16_t addr = 0; addr < eeprom_geom->words; addr++) {
+        // Write data from buffer to EEPROM
+        eeprom_write(spi, cs_pin, addr, eeprom_buffer[addr]);
+    }
+    #endif
+    
+    printf("Buffer contents written to EEPROM\r\n");
+}
+
+/*
+Usage: const char *message = "Hello, EEPROM!";
+       eeprom_write_string(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x100, message);
+*/
+void eeprom_write_string(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, const char *str) {
+    uint16_t word;
+    size_t i = 0;
+
+    while (str[i] != '\0') {
+        // Combine two characters into a 16-bit word (big-endian)
+        word = (str[i] << 8) | (str[i + 1] != '\0' ? str[i + 1] : 0);
+        eeprom_write(spi, cs_pin, start_addr++, word);
+
+        // Move to the next pair of characters
+        i += 2;
+    }
+}
+
+void print_buffer(uint16_t eeprom_buffer[0x400]) {
+    for(int i = 0; i < eeprom_geom->words; i++) {
+        // Print the data in a formatted manner
+        if (i % 16 == 0) {
+            printf("\n%04X  | ", i);
+        }
+        printf("%04X ", eeprom_buffer[i]);
+    }
+}
+
+/* SEQUENTIAL READ */
+/**
+ * @brief Realign a raw sequential-read bitstream into words
+ * @details After the READ frame DO carries the dummy 0 followed by D15..D0 of every word back to back,
+ * \details so word k is bits 1+16k .. 16+16k of the stream: raw must hold 2n+1 bytes.
+ * \details Two words come out of each big-endian 32-bit load (REV + shift on the M0+). Safe to run in place
+ * \details with out aliasing raw, since each pair is loaded before it is overwritten.
+ */
+static inline void eeprom_realign(const uint8_t *raw, uint16_t *out, size_t n) {
+    size_t k = 0;
+    for (; k + 2 <= n; k += 2) {
+        uint32_t x;
+        memcpy(&x, raw + 2 * k, 4);
+        x = __builtin_bswap32(x);
+        uint8_t next = raw[2 * k + 4];
+        out[k]     = (uint16_t)(x >> 15);
+        out[k + 1] = (uint16_t)((x << 1) | (next >> 7));
+    }
+    if (k < n) {
+        out[k] = (uint16_t)((raw[2 * k] << 9) | (raw[2 * k + 1] << 1) | (raw[2 * k + 2] >> 7));
+    }
+}
+
+/// @brief Per-word reference for eeprom_realign (same maths as eeprom_read), kept for the benchmark
+static void eeprom_realign_scalar(const uint8_t *raw, uint16_t *out, size_t n) {
+    for (size_t k = 0; k < n; k++) {
+        out[k] = ((uint16_t)(raw[2 * k] << 9)) | ((uint16_t)(raw[2 * k + 1] << 1)) | ((raw[2 * k + 2] >> 7) & 0x01);
+    }
+}
+
+#define EEPROM_STREAM_CHUNK 64 // Raw bytes buffered per chunk: RAM use does not depend on the read length
+
+/**
+ * @brief State of one sequential READ in progress
+ * @details The raw stream is clocked out chunk by chunk into ring and realigned straight into the caller's
+ * \details buffer. ring[0] carries the last byte of the previous chunk, which still holds D0 of its last word.
+ */
+typedef struct {
+    spi_inst_t *spi;
+    uint cs_pin;
+    uint8_t ring[EEPROM_STREAM_CHUNK];
+} eeprom_stream_t;
+
+/// @brief Send READ for start_addr and clock in the byte holding the dummy bit; CS stays high until eeprom_stream_end
+static void eeprom_stream_begin(eeprom_stream_t *st, spi_inst_t *spi, uint cs_pin, uint16_t start_addr) {
+    st->spi = spi;
+    st->cs_pin = cs_pin;
+
+    cs_deselect(cs_pin);
+    delay_250ns();
+    cs_select(cs_pin);
+
+    uint8_t cmdbuf[2] = EEPROM_FRAME16_BYTES(eeprom_frame_read(start_addr));
+    spi_write_blocking(spi, cmdbuf, 2);
+    spi_read_blocking(spi, 0, st->ring, 1); // Dummy bit + D15..D9 of the first word
+}
+
+/// @brief Clock out the next n words of the stream into out, at most EEPROM_STREAM_CHUNK bytes at a time
+static void eeprom_stream_read(eeprom_stream_t *st, uint16_t *out, size_t n) {
+    while (n) {
+        size_t m = MIN(n, (EEPROM_STREAM_CHUNK - 1) / 2);
+        spi_read_blocking(st->spi, 0, st->ring + 1, 2 * m);
+        eeprom_realign(st->ring, out, m);
+        st->ring[0] = st->ring[2 * m];
+        out += m;
+        n -= m;
+    }
+}
+
+/// @brief Finish (or abort) the stream: the part stops driving DO as soon as CS goes low
+static inline void eeprom_stream_end(eeprom_stream_t *st) {
+    cs_deselect(st->cs_pin);
+}
+
+void eeprom_sequential_read_length(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, uint16_t *buf, size_t length) {
+    if (length == 0) return;
+
+    eeprom_stream_t st;
+    eeprom_stream_begin(&st, spi, cs_pin, start_addr);
+    eeprom_stream_read(&st, buf, length);
+    eeprom_stream_end(&st);
+}
+void eeprom_sequential_read_range(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, uint16_t end_addr, uint16_t *buf) {
+    if (start_addr > end_addr) return;
+
+    eeprom_sequential_read_length(spi, cs_pin, start_addr, buf, end_addr - start_addr + 1);
+}
+
+/// @brief eeprom_sequential_read_length on a shared bus, holding it for the one READ
+void eeprom_bus_read(spi_bus_t *bus, const spi_device_t *dev, uint16_t start_addr, uint16_t *buf, size_t length) {
+    spi_bus_acquire(bus, dev);
+    eeprom_sequential_read_length(bus->spi, dev->cs_pin, start_addr, buf, length);
+    spi_bus_release(bus);
+}
+
+/**
+ * @brief Read a NUL-terminated string (two characters per word, first in the high byte) into str
+ * @details One sequential READ, clocked a word at a time: CS drops as soon as the terminator is seen or
+ * \details str is full, so a 64-character label costs one command plus 32 words.
+ * @param max_len size of str including the terminator; str is always NUL-terminated
+ */
+void eeprom_read_string(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, char *str, size_t max_len) {
+    eeprom_stream_t st;
+    uint16_t word;
+    size_t i = 0;
+
+    if (max_len == 0) return;
+
+    eeprom_stream_begin(&st, spi, cs_pin, start_addr);
+    while (i < max_len - 1) { // Reserve space for the null terminator
+        eeprom_stream_read(&st, &word, 1);
+
+        // Extract the two characters from the 16-bit word (big-endian)
+        char hi = (char)(word >> 8);
+        char lo = (char)(word & 0xFF);
+        if (hi == '\0') break;
+        str[i++] = hi;
+        if (lo == '\0' || i == max_len - 1) break;
+        str[i++] = lo;
+    }
+    eeprom_stream_end(&st);
+
+    // Ensure the string is null-terminated
+    str[i] = '\0';
+}
+
+static int eeprom_dma_tx = -1;
+static int eeprom_dma_rx = -1;
+
+/**
+ * @brief Sequential READ with the raw stream DMA'd straight into the caller's buffer
+ * @details The 2L bytes that follow the dummy-bit byte land in buf itself and are realigned in place,
+ * \details trailing the RX DMA write pointer, so there is no intermediate buffer and the realign runs
+ * \details while the bus is still clocking: total time is the bus time of the transfer.
+ */
+void eeprom_read_bulk(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, uint16_t *buf, size_t length) {
+    static const uint8_t zero = 0;
+    uint8_t *raw = (uint8_t *)buf;
+    size_t nbytes = 2 * length;
+
+    if (length == 0) return;
+
+    if (eeprom_dma_tx < 0) {
+        eeprom_dma_tx = dma_claim_unused_channel(true);
+        eeprom_dma_rx = dma_claim_unused_channel(true);
+    }
+
+    eeprom_stream_t st;
+    eeprom_stream_begin(&st, spi, cs_pin, start_addr);
+
+    // TX clocks out zeros from a fixed byte, RX fills buf
+    dma_channel_config c = dma_channel_get_default_config(eeprom_dma_tx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, spi_get_dreq(spi, true));
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_configure(eeprom_dma_tx, &c, &spi_get_hw(spi)->dr, &zero, nbytes, false);
+
+    c = dma_channel_get_default_config(eeprom_dma_rx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_dreq(&c, spi_get_dreq(spi, false));
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    dma_channel_configure(eeprom_dma_rx, &c, raw, &spi_get_hw(spi)->dr, nbytes, false);
+
+    dma_start_channel_mask((1u << eeprom_dma_tx) | (1u << eeprom_dma_rx));
+
+    // Word k needs raw[2k-1..2k+1] (raw[-1] is the dummy-bit byte) and overwrites raw[2k..2k+1],
+    // so the byte still needed by word k+1 is carried in a register
+    uint8_t carry = st.ring[0];
+    size_t k = 0;
+    while (k < length) {
+        // Stay one byte behind TRANS_COUNT so the byte being written is never read
+        size_t received = nbytes - dma_channel_hw_addr(eeprom_dma_rx)->transfer_count;
+        if (received < 2 * k + 3 && received != nbytes) continue;
+        if (received == nbytes) dma_channel_wait_for_finish_blocking(eeprom_dma_rx);
+
+        uint8_t hi = raw[2 * k];
+        uint8_t lo = raw[2 * k + 1];
+        buf[k++] = (uint16_t)((carry << 9) | (hi << 1) | (lo >> 7));
+        carry = lo;
+    }
+
+    dma_channel_wait_for_finish_blocking(eeprom_dma_tx);
+    eeprom_stream_end(&st);
+}
+
+#define EEPROM_BLANK_FIRST_WORDS 2 // First chunk is tiny so a programmed part is rejected after a few bytes
+
+/**
+ * @brief Check that length words from start_addr all read 0xFFFF, stopping at the first one that does not
+ * @details The raw stream is checked without realigning it: past the dummy bit a blank range is all ones,
+ * \details so every raw byte must be 0xFF (the lead byte 0x7F, and only the MSB of the final byte counts).
+ * \details Chunks are 4-byte aligned and compared a uint32_t at a time. The first chunk is
+ * \details EEPROM_BLANK_FIRST_WORDS words and each following one doubles, up to EEPROM_STREAM_CHUNK bytes,
+ * \details so a blank range costs about one bulk read and a programmed one is rejected almost at once.
+ * \details Only the chunk that failed is realigned, to locate the word.
+ * \details A missing part also reads all ones, so a missing dummy bit counts as not blank.
+ * @param first_dirty if not NULL, set to the address of the first non-blank word (start_addr if no dummy bit)
+ */
+bool eeprom_is_blank(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, size_t length, uint16_t *first_dirty) {
+    // raw8[3] is the byte carried from the previous chunk, raw8[4..] the chunk itself (word aligned)
+    uint32_t raw32[EEPROM_STREAM_CHUNK / 4 + 1];
+    uint8_t *raw8 = (uint8_t *)raw32;
+    eeprom_stream_t st;
+    size_t done = 0;
+    size_t m = EEPROM_BLANK_FIRST_WORDS;
+    bool blank = true;
+
+    if (length == 0) return true;
+
+    eeprom_stream_begin(&st, spi, cs_pin, start_addr);
+    if (st.ring[0] != 0x7F) {
+        eeprom_stream_end(&st);
+        if (first_dirty) *first_dirty = start_addr;
+        return false;
+    }
+    raw8[3] = st.ring[0];
+
+    while (done < length) {
+        m = MIN(m, length - done);
+        size_t nbytes = 2 * m;
+        spi_read_blocking(spi, 0, raw8 + 4, nbytes);
+
+        // The last byte of the final chunk only carries D0; its other bits belong to the word after the range
+        bool last = (done + m == length);
+        size_t whole = last ? nbytes - 1 : nbytes;
+        size_t i = 0;
+        for (; i + 4 <= whole; i += 4) {
+            if (raw32[1 + i / 4] != 0xFFFFFFFFu) break;
+        }
+        for (; i < whole && raw8[4 + i] == 0xFF; i++);
+        if (i < whole || (last && !(raw8[4 + nbytes - 1] & 0x80))) {
+            blank = false;
+            if (first_dirty) {
+                uint16_t words[EEPROM_STREAM_CHUNK / 2];
+                eeprom_realign(raw8 + 3, words, m);
+                size_t k = 0;
+                while (k < m && words[k] == 0xFFFF) k++;
+                *first_dirty = (start_addr + done + k) & eeprom_geom->addr_mask;
+            }
+            break;
+        }
+
+        raw8[3] = raw8[4 + nbytes - 1];
+        done += m;
+        m = MIN(2 * m, EEPROM_STREAM_CHUNK / 2);
+    }
+
+    eeprom_stream_end(&st);
+    return blank;
+}
+
+#define EEPROM_FIND_MAX_PATTERN 32
+
+/**
+ * @brief Find every occurrence of a word pattern in the whole part in one sequential read
+ * @details KMP over the word stream: each word read is looked at once and only the pattern's failure
+ * \details table and one stream chunk are held in RAM, never the image. Words are compared under mask
+ * \details (e.g. 0xFF00 to ignore the low byte of a serial number), which keeps KMP valid since the
+ * \details same mask applies to every position. Matches do not wrap from the last word to 0x000.
+ * @param matches start address of each match, in address order; at most max_matches are stored
+ * @return the total number of matches, which may be larger than max_matches
+ */
+size_t eeprom_find(spi_inst_t *spi, uint cs_pin, const uint16_t *pattern, size_t len, uint16_t mask,
+                   uint16_t *matches, size_t max_matches) {
+    uint8_t fail[EEPROM_FIND_MAX_PATTERN];
+    uint16_t pat[EEPROM_FIND_MAX_PATTERN];
+    uint16_t words[EEPROM_STREAM_CHUNK / 2];
+    eeprom_stream_t st;
+    size_t found = 0;
+    size_t q = 0;
+
+    if (len == 0 || len > EEPROM_FIND_MAX_PATTERN) return 0;
+
+    // fail[i]: length of the longest proper prefix of pat[0..i] that is also its suffix
+    for (size_t i = 0; i < len; i++) pat[i] = pattern[i] & mask;
+    fail[0] = 0;
+    for (size_t i = 1, k = 0; i < len; i++) {
+        while (k && pat[i] != pat[k]) k = fail[k - 1];
+        if (pat[i] == pat[k]) k++;
+        fail[i] = k;
+    }
+
+    eeprom_stream_begin(&st, spi, cs_pin, 0);
+    for (uint16_t base = 0; base < eeprom_geom->words; base += count_of(words)) {
+        size_t n = MIN(count_of(words), eeprom_geom->words - base);
+        eeprom_stream_read(&st, words, n);
+        for (size_t j = 0; j < n; j++) {
+            uint16_t w = words[j] & mask;
+            while (q && w != pat[q]) q = fail[q - 1];
+            if (w == pat[q]) q++;
+            if (q == len) {
+                if (found < max_matches) matches[found] = base + j + 1 - len;
+                found++;
+                q = fail[q - 1];
+            }
+        }
+    }
+    eeprom_stream_end(&st);
+    return found;
+}
+
+/// @brief Clock n words of the stream through without keeping them
+static void eeprom_stream_skip(eeprom_stream_t *st, size_t n) {
+    uint16_t scratch[16];
+    while (n) {
+        size_t m = MIN(n, count_of(scratch));
+        eeprom_stream_read(st, scratch, m);
+        n -= m;
+    }
+}
+
+/**
+ * @brief Write buf to start_addr, programming only the words whose contents differ
+ * @details The old contents are streamed a chunk at a time and compared; each differing word is written
+ * \details with ready polling instead of the fixed tWP delay. Unchanged words cost two bytes of bus time.
+ * \details Programming must already be enabled (EWEN).
+ * @return the number of words programmed, or -1 if a program cycle did not finish within tWP
+ */
+int eeprom_update_buf(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, const uint16_t *buf, size_t len) {
+    uint16_t old[EEPROM_STREAM_CHUNK / 2];
+    int programmed = 0;
+
+    for (size_t done = 0; done < len; done += count_of(old)) {
+        size_t m = MIN(len - done, count_of(old));
+        eeprom_sequential_read_length(spi, cs_pin, start_addr + done, old, m);
+        for (size_t i = 0; i < m; i++) {
+            if (old[i] == buf[done + i]) continue;
+            eeprom_write_start(spi, cs_pin, start_addr + done + i, buf[done + i]);
+            if (!eeprom_wait_ready(cs_pin, EEPROM_TWP_MAX_US)) return -1;
+            programmed++;
+        }
+    }
+    return programmed;
+}
+
+/* STRING TABLE */
+/**
+ * Layout, in words from the table base:
+ *   [0]          EEPROM_STRTAB_MAGIC
+ *   [1]          number of strings n
+ *   [2 .. n+1]   offset of each entry from the base
+ *   entry        byte length, then the characters packed two per word (first one in the high byte),
+ *                padded with 0xFFFF to a multiple of EEPROM_STRTAB_SLOT words
+ * No terminator is stored. The padding means a label can usually be renamed without moving the
+ * entries after it, so eeprom_strtab_write only programs the words of the label itself.
+ */
+#define EEPROM_STRTAB_MAGIC     0x5354 // "ST"
+#define EEPROM_STRTAB_SLOT      4
+#ifdef EEPROM_LOW_MEM
+#define EEPROM_STRTAB_MAX_WORDS 0x40 // The image is built on the stack
+#else
+#define EEPROM_STRTAB_MAX_WORDS 0x100
+#endif
+
+/**
+ * @brief Lay out strs as a string table image in RAM
+ * @return the number of words used, or 0 if the table does not fit in max_words
+ */
+size_t eeprom_strtab_build(const char *const *strs, size_t n, uint16_t *image, size_t max_words) {
+    size_t pos = 2 + n;
+
+    if (pos > max_words) return 0;
+    image[0] = EEPROM_STRTAB_MAGIC;
+    image[1] = n;
+
+    for (size_t i = 0; i < n; i++) {
+        size_t len = strlen(strs[i]);
+        size_t words = 1 + (len + 1) / 2;
+        size_t slot = (words + EEPROM_STRTAB_SLOT - 1) / EEPROM_STRTAB_SLOT * EEPROM_STRTAB_SLOT;
+
+        if (len > 0xFFFF || pos + slot > max_words) return 0;
+        image[2 + i] = pos;
+        image[pos] = len;
+        for (size_t c = 0; c < len; c += 2) {
+            image[pos + 1 + c / 2] = (uint16_t)((uint8_t)strs[i][c] << 8) | (c + 1 < len ? (uint8_t)strs[i][c + 1] : 0);
+        }
+        for (size_t w = words; w < slot; w++) image[pos + w] = 0xFFFF;
+        pos += slot;
+    }
+    return pos;
+}
+
+/**
+ * @brief Build the table for strs and program it at base, touching only the words that changed
+ * @return the number of words programmed, or -1 if the table does not fit or a write timed out
+ */
+int eeprom_strtab_write(spi_inst_t *spi, uint cs_pin, uint16_t base, const char *const *strs, size_t n) {
+    uint16_t image[EEPROM_STRTAB_MAX_WORDS];
+    size_t words = eeprom_strtab_build(strs, n, image, count_of(image));
+
+    if (words == 0) return -1;
+    return eeprom_update_buf(spi, cs_pin, base, image, words);
+}
+
+/**
+ * @brief Fetch string idx of the table at base in one sequential READ
+ * @details The stream runs from the header through the index to the entry and stops after its last
+ * \details character, so a lookup costs one command plus the words up to the end of that string.
+ * \details Strings longer than out_size - 1 are truncated; out is always NUL-terminated.
+ * @return the stored length of the string, or -1 if there is no table at base or idx is out of range
+ */
+int eeprom_strtab_get(spi_inst_t *spi, uint cs_pin, uint16_t base, size_t idx, char *out, size_t out_size) {
+    eeprom_stream_t st;
+    uint16_t header[2], offset, len;
+    uint16_t chunk[16];
+
+    if (out_size == 0) return -1;
+    out[0] = '\0';
+
+    eeprom_stream_begin(&st, spi, cs_pin, base);
+    eeprom_stream_read(&st, header, 2);
+    if (header[0] != EEPROM_STRTAB_MAGIC || idx >= header[1]) {
+        eeprom_stream_end(&st);
+        return -1;
+    }
+    eeprom_stream_skip(&st, idx);
+    eeprom_stream_read(&st, &offset, 1);
+    if (offset < 3 + idx) {
+        eeprom_stream_end(&st);
+        return -1;
+    }
+    eeprom_stream_skip(&st, offset - (3 + idx));
+    eeprom_stream_read(&st, &len, 1);
+
+    size_t keep = MIN(len, out_size - 1);
+    for (size_t c = 0; c < keep; ) {
+        size_t m = MIN((keep - c + 1) / 2, count_of(chunk));
+        eeprom_stream_read(&st, chunk, m);
+        for (size_t w = 0; w < m && c < keep; w++) {
+            out[c++] = (char)(chunk[w] >> 8);
+            if (c < keep) out[c++] = (char)(chunk[w] & 0xFF);
+        }
+    }
+    eeprom_stream_end(&st);
+    out[keep] = '\0';
+    return len;
+}
+
+/* RECORDS */
+/**
+ * Typed records: a struct whose RAM copy is the word image in the part, word for word.
+ *
+ *   typedef struct { uint16_t gain; uint16_t offset; uint32_t serial; } cal_t;
+ *   EEPROM_RECORD(cal, cal_t, 0x2C0);
+ *
+ *   eeprom_record_load(spi, cs, &cal);
+ *   uint16_t g = EEPROM_RECORD_VIEW(cal)->gain;      // read straight from the mirror
+ *   EEPROM_RECORD_SET(cal, offset, 12);              // marks only the words of .offset dirty
+ *   eeprom_record_flush(spi, cs, &cal);              // programs those words, nothing else
+ *
+ * Fields are stored in the struct's in-memory order and byte order (little-endian words on the RP2040),
+ * so keep the layout explicit: fixed-width fields, no implicit padding.
+ */
+#define EEPROM_RECORD_MAX_WORDS 64
+
+typedef struct {
+    uint16_t base;
+    uint16_t words;
+    uint16_t *mirror;
+    uint32_t dirty[EEPROM_RECORD_MAX_WORDS / 32];
+} eeprom_record_t;
+
+#define EEPROM_RECORD(name, type, addr)                                                              \
+    _Static_assert(sizeof(type) % 2 == 0, #type " is not a whole number of words");                  \
+    _Static_assert(sizeof(type) / 2 <= EEPROM_RECORD_MAX_WORDS, #type " is larger than a record");   \
+    _Static_assert((addr) + sizeof(type) / 2 <= EEPROM_ADDR_MASK + 1, #name " runs past the largest part"); \
+    static union { type view; uint16_t words[sizeof(type) / 2]; } name##_mirror;                     \
+    static eeprom_record_t name = { (addr), sizeof(type) / 2, name##_mirror.words, {0} }
+
+/// @brief Typed pointer into the RAM mirror; reads never touch the bus
+#define EEPROM_RECORD_VIEW(name) (&name##_mirror.view)
+
+/// @brief Assign one field in the mirror and mark the words it occupies dirty
+#define EEPROM_RECORD_SET(name, field, value) do {                                                   \
+        name##_mirror.view.field = (value);                                                          \
+        eeprom_record_touch(&name, offsetof(__typeof__(name##_mirror.view), field),                  \
+                            sizeof(name##_mirror.view.field));                                       \
+    } while (0)
+
+/// @brief Mark the words covering bytes [offset, offset + size) of the record dirty
+static inline void eeprom_record_touch(eeprom_record_t *rec, size_t offset, size_t size) {
+    for (size_t w = offset / 2; w <= (offset + size - 1) / 2; w++) {
+        rec->dirty[w / 32] |= 1u << (w % 32);
+    }
+}
+
+static inline bool eeprom_record_fits(const eeprom_record_t *rec) {
+    return rec->base + rec->words <= eeprom_geom->words;
+}
+
+/**
+ * @brief Fill the mirror with one sequential READ and clear the dirty map
+ * @return false if the record runs past the end of the probed part (the mirror is left as it was)
+ */
+bool eeprom_record_load(spi_inst_t *spi, uint cs_pin, eeprom_record_t *rec) {
+    if (!eeprom_record_fits(rec)) return false;
+    eeprom_sequential_read_length(spi, cs_pin, rec->base, rec->mirror, rec->words);
+    memset(rec->dirty, 0, sizeof(rec->dirty));
+    return true;
+}
+
+/**
+ * @brief Program the dirty words of the record, with ready polling
+ * @details A word stays dirty if its program cycle times out, so a later flush retries it.
+ * \details Programming must already be enabled (EWEN).
+ * @return the number of words programmed, or -1 on a timeout or if the record does not fit the probed part
+ */
+int eeprom_record_flush(spi_inst_t *spi, uint cs_pin, eeprom_record_t *rec) {
+    int programmed = 0;
+
+    if (!eeprom_record_fits(rec)) return -1;
+
+    for (uint w = 0; w < rec->words; w++) {
+        if (!(rec->dirty[w / 32] & (1u << (w % 32)))) continue;
+        eeprom_write_start(spi, cs_pin, rec->base + w, rec->mirror[w]);
+        if (!eeprom_wait_ready(cs_pin, EEPROM_TWP_MAX_US)) return -1;
+        rec->dirty[w / 32] &= ~(1u << (w % 32));
+        programmed++;
+    }
+    return programmed;
+}
+
+/* CONFIG SCHEMA */
+/**
+ * Versioned config region, in words from its base:
+ *   [0]     EEPROM_CFG_MAGIC
+ *   [1]     schema version the whole region was last brought up to
+ *   [2]     number of field table entries in use
+ *   [3 ..]  EEPROM_CFG_MAX_FIELDS entries of 3 words: id << 8 | words, offset from base, field version
+ *   data    from EEPROM_CFG_DATA_START on, placed by the firmware's schema
+ *
+ * A firmware upgrade does not rewrite the region. A field is migrated the first time it is read or
+ * written and its table entry does not match the schema (moved, resized or a newer field version):
+ * the old words are read, passed through the field's migrate hook, written to the new place with
+ * eeprom_update_buf, and then the entry is updated. Fields still waiting for migration whose old words
+ * sit where the new ones go are migrated first, so nothing is overwritten before it has been read.
+ * The data is always written before the table entry that points at it.
+ */
+#define EEPROM_CFG_MAGIC        0x4346 // "CF"
+#define EEPROM_CFG_MAX_FIELDS   16
+#define EEPROM_CFG_FIELD_WORDS  8
+#define EEPROM_CFG_DATA_START   (3 + 3 * EEPROM_CFG_MAX_FIELDS)
+
+/**
+ * @brief Convert a field from the layout it was stored with
+ * @param old the stored words, or NULL (old_words 0) for a field that did not exist before
+ * @param out words of the current layout; prefilled with the old words, 0xFFFF past them
+ */
+typedef void (*eeprom_cfg_migrate_t)(uint16_t from_version, const uint16_t *old, size_t old_words, uint16_t *out);
+
+typedef struct {
+    uint8_t  id;
+    uint8_t  words;    // At most EEPROM_CFG_FIELD_WORDS
+    uint16_t offset;   // From the region base, at least EEPROM_CFG_DATA_START
+    uint16_t version;  // Schema version in which this field's layout last changed
+    eeprom_cfg_migrate_t migrate;
+} eeprom_cfg_field_t;
+
+typedef struct {
+    spi_inst_t *spi;
+    uint cs_pin;
+    uint16_t base;
+    const eeprom_cfg_field_t *schema;
+    size_t n_fields;
+    uint16_t version;
+    uint16_t header[3];
+    uint16_t table[EEPROM_CFG_MAX_FIELDS][3]; // Copy of the field table as it is on the part
+} eeprom_cfg_t;
+
+static int eeprom_cfg_find_stored(const eeprom_cfg_t *cfg, uint8_t id) {
+    for (int j = 0; j < cfg->header[2]; j++) {
+        if ((cfg->table[j][0] >> 8) == id) return j;
+    }
+    return -1;
+}
+
+static bool eeprom_cfg_is_current(const eeprom_cfg_t *cfg, const eeprom_cfg_field_t *f) {
+    int j = eeprom_cfg_find_stored(cfg, f->id);
+    return j >= 0 && cfg->table[j][0] == ((f->id << 8) | f->words) && cfg->table[j][1] == f->offset &&
+           cfg->table[j][2] == f->version;
+}
+
+static int eeprom_cfg_migrate(eeprom_cfg_t *cfg, size_t k, uint32_t *in_progress) {
+    const eeprom_cfg_field_t *f = &cfg->schema[k];
+    uint16_t old[EEPROM_CFG_FIELD_WORDS];
+    uint16_t val[EEPROM_CFG_FIELD_WORDS];
+    size_t old_words = 0;
+    uint16_t from_version = 0;
+    int j = eeprom_cfg_find_stored(cfg, f->id);
+
+    if (eeprom_cfg_is_current(cfg, f)) return 0;
+    // A new field needs a table entry; with none left, fail before any data is programmed
+    if (j < 0 && cfg->header[2] >= EEPROM_CFG_MAX_FIELDS) return -1;
+    *in_progress |= 1u << k;
+
+    if (j >= 0) {
+        old_words = MIN(cfg->table[j][0] & 0xFF, EEPROM_CFG_FIELD_WORDS);
+        from_version = cfg->table[j][2];
+        eeprom_sequential_read_length(cfg->spi, cfg->cs_pin, cfg->base + cfg->table[j][1], old, old_words);
+    }
+    for (size_t w = 0; w < f->words; w++) val[w] = (w < old_words) ? old[w] : 0xFFFF;
+    if (f->migrate) f->migrate(from_version, old_words ? old : NULL, old_words, val);
+
+    // Anything not yet migrated that still lives where this field is going has to move out first
+    for (size_t g = 0; g < cfg->n_fields; g++) {
+        if (g == k || (*in_progress & (1u << g))) continue;
+        int jg = eeprom_cfg_find_stored(cfg, cfg->schema[g].id);
+        if (jg < 0 || eeprom_cfg_is_current(cfg, &cfg->schema[g])) continue;
+        uint16_t lo = cfg->table[jg][1], hi = lo + (cfg->table[jg][0] & 0xFF);
+        if (lo < f->offset + f->words && f->offset < hi) {
+            if (eeprom_cfg_migrate(cfg, g, in_progress) < 0) return -1;
+        }
+    }
+
+    // Fields migrated above already had entries, so the next free one is still free
+    if (j < 0) j = cfg->header[2];
+    if (eeprom_update_buf(cfg->spi, cfg->cs_pin, cfg->base + f->offset, val, f->words) < 0) return -1;
+
+    cfg->table[j][0] = (f->id << 8) | f->words;
+    cfg->table[j][1] = f->offset;
+    cfg->table[j][2] = f->version;
+    if (eeprom_update_buf(cfg->spi, cfg->cs_pin, cfg->base + 3 + 3 * j, cfg->table[j], 3) < 0) return -1;
+    if (j == cfg->header[2]) {
+        cfg->header[2]++;
+        if (eeprom_update_buf(cfg->spi, cfg->cs_pin, cfg->base + 2, &cfg->header[2], 1) < 0) return -1;
+    }
+    *in_progress &= ~(1u << k);
+
+    // Once the last pending field has moved the region as a whole is at the new version
+    for (size_t g = 0; g < cfg->n_fields; g++) {
+        if (!eeprom_cfg_is_current(cfg, &cfg->schema[g])) return 1;
+    }
+    if (cfg->header[1] != cfg->version) {
+        cfg->header[1] = cfg->version;
+        if (eeprom_update_buf(cfg->spi, cfg->cs_pin, cfg->base + 1, &cfg->header[1], 1) < 0) return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Attach to the config region at base, formatting it if it has never been written
+ * @details Reads the header and field table in one sequential READ. Nothing is migrated here.
+ * \details Programming must already be enabled (EWEN).
+ * @return false if the region could not be formatted
+ */
+bool eeprom_cfg_open(eeprom_cfg_t *cfg, spi_inst_t *spi, uint cs_pin, uint16_t base,
+                     const eeprom_cfg_field_t *schema, size_t n_fields, uint16_t version) {
+    uint16_t raw[EEPROM_CFG_DATA_START];
+
+    *cfg = (eeprom_cfg_t){ .spi = spi, .cs_pin = cs_pin, .base = base, .schema = schema,
+                           .n_fields = n_fields, .version = version };
+    if (n_fields > EEPROM_CFG_MAX_FIELDS) return false;
+
+    eeprom_sequential_read_length(spi, cs_pin, base, raw, count_of(raw));
+    if (raw[0] == EEPROM_CFG_MAGIC && raw[2] <= EEPROM_CFG_MAX_FIELDS) {
+        memcpy(cfg->header, raw, sizeof(cfg->header));
+        memcpy(cfg->table, raw + 3, sizeof(cfg->table));
+        return true;
+    }
+
+    // Fresh region: an empty table at the current version, fields appear as they are first touched
+    cfg->header[0] = EEPROM_CFG_MAGIC;
+    cfg->header[1] = version;
+    cfg->header[2] = 0;
+    return eeprom_update_buf(spi, cs_pin, base, cfg->header, 3) >= 0;
+}
+
+static int eeprom_cfg_field_index(const eeprom_cfg_t *cfg, uint8_t id) {
+    for (size_t k = 0; k < cfg->n_fields; k++) {
+        if (cfg->schema[k].id == id) return k;
+    }
+    return -1;
+}
+
+/**
+ * @brief Read field id into out (schema words long), migrating it first if needed
+ * @return the number of words read, or -1 for an unknown id or a failed migration
+ */
+int eeprom_cfg_get(eeprom_cfg_t *cfg, uint8_t id, uint16_t *out) {
+    uint32_t in_progress = 0;
+    int k = eeprom_cfg_field_index(cfg, id);
+
+    if (k < 0 || eeprom_cfg_migrate(cfg, k, &in_progress) < 0) return -1;
+    eeprom_sequential_read_length(cfg->spi, cfg->cs_pin, cfg->base + cfg->schema[k].offset, out, cfg->schema[k].words);
+    return cfg->schema[k].words;
+}
+
+/**
+ * @brief Write field id from data, migrating the table entry first if needed
+ * @return the number of words programmed, or -1 for an unknown id or a failed write
+ */
+int eeprom_cfg_set(eeprom_cfg_t *cfg, uint8_t id, const uint16_t *data) {
+    uint32_t in_progress = 0;
+    int k = eeprom_cfg_field_index(cfg, id);
+
+    if (k < 0 || eeprom_cfg_migrate(cfg, k, &in_progress) < 0) return -1;
+    return eeprom_update_buf(cfg->spi, cfg->cs_pin, cfg->base + cfg->schema[k].offset, data, cfg->schema[k].words);
+}
+
+/* LOW MEMORY */
+/**
+ * Whole-part operations that never hold more than one chunk: the stream's EEPROM_STREAM_CHUNK-byte ring
+ * plus EEPROM_CHUNK_WORDS words, 128 bytes in all. Reference data (verify, diff-paste) can stay in flash.
+ * Build with EEPROM_LOW_MEM to make main and eeprom_paste use them instead of a full RAM image.
+ */
+#define EEPROM_CHUNK_WORDS (EEPROM_STREAM_CHUNK / 2)
+
+/// @brief Receives consecutive chunks of the part from eeprom_copy_chunked
+typedef void (*eeprom_sink_t)(void *ctx, uint16_t addr, const uint16_t *words, size_t n);
+
+/// @brief Modifies a chunk in place for eeprom_transform_chunked
+typedef void (*eeprom_transform_t)(void *ctx, uint16_t addr, uint16_t *words, size_t n);
+
+/// @brief Stream length words from start_addr through sink, one chunk at a time, in one sequential READ
+void eeprom_copy_chunked(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, size_t length, eeprom_sink_t sink, void *ctx) {
+    uint16_t chunk[EEPROM_CHUNK_WORDS];
+    eeprom_stream_t st;
+
+    if (length == 0) return;
+
+    eeprom_stream_begin(&st, spi, cs_pin, start_addr);
+    for (size_t done = 0; done < length; done += count_of(chunk)) {
+        size_t m = MIN(length - done, count_of(chunk));
+        eeprom_stream_read(&st, chunk, m);
+        sink(ctx, (start_addr + done) & eeprom_geom->addr_mask, chunk, m);
+    }
+    eeprom_stream_end(&st);
+}
+
+/**
+ * @brief Compare length words from start_addr against expect in one sequential READ
+ * @return the address of the first word that differs, or -1 if they all match
+ */
+int eeprom_verify_chunked(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, const uint16_t *expect, size_t length) {
+    uint16_t chunk[EEPROM_CHUNK_WORDS];
+    eeprom_stream_t st;
+    int mismatch = -1;
+
+    if (length == 0) return -1;
+
+    eeprom_stream_begin(&st, spi, cs_pin, start_addr);
+    for (size_t done = 0; done < length && mismatch < 0; done += count_of(chunk)) {
+        size_t m = MIN(length - done, count_of(chunk));
+        eeprom_stream_read(&st, chunk, m);
+        for (size_t i = 0; i < m; i++) {
+            if (chunk[i] != expect[done + i]) {
+                mismatch = (start_addr + done + i) & eeprom_geom->addr_mask;
+                break;
+            }
+        }
+    }
+    eeprom_stream_end(&st);
+    return mismatch;
+}
+
+/**
+ * @brief Read-modify-write length words a chunk at a time, programming only the words fn changed
+ * @details Chunks are half size here, since the original words are kept next to the modified ones.
+ * \details Programming must already be enabled (EWEN).
+ * @return the number of words programmed, or -1 if a program cycle did not finish within tWP
+ */
+int eeprom_transform_chunked(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, size_t length, eeprom_transform_t fn, void *ctx) {
+    uint16_t orig[EEPROM_CHUNK_WORDS / 2];
+    uint16_t chunk[EEPROM_CHUNK_WORDS / 2];
+    int programmed = 0;
+
+    for (size_t done = 0; done < length; done += count_of(chunk)) {
+        size_t m = MIN(length - done, count_of(chunk));
+        uint16_t addr = (start_addr + done) & eeprom_geom->addr_mask;
+        eeprom_sequential_read_length(spi, cs_pin, addr, orig, m);
+        memcpy(chunk, orig, m * sizeof(chunk[0]));
+        fn(ctx, addr, chunk, m);
+        for (size_t i = 0; i < m; i++) {
+            if (chunk[i] == orig[i]) continue;
+            eeprom_write_start(spi, cs_pin, addr + i, chunk[i]);
+            if (!eeprom_wait_ready(cs_pin, EEPROM_TWP_MAX_US)) return -1;
+            programmed++;
+        }
+    }
+    return programmed;
+}
+
+/**
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) of length words, high byte first, in one sequential READ
+ * @details Bitwise rather than table driven, so it needs no RAM beyond the chunk; at 1 MHz the bus is
+ * \details still the slower of the two.
+ */
+uint16_t eeprom_crc16(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, size_t length) {
+    uint16_t chunk[EEPROM_CHUNK_WORDS];
+    eeprom_stream_t st;
+    uint16_t crc = 0xFFFF;
+
+    if (length == 0) return crc;
+
+    eeprom_stream_begin(&st, spi, cs_pin, start_addr);
+    for (size_t done = 0; done < length; done += count_of(chunk)) {
+        size_t m = MIN(length - done, count_of(chunk));
+        eeprom_stream_read(&st, chunk, m);
+        for (size_t i = 0; i < m; i++) {
+            crc ^= chunk[i];
+            for (int b = 0; b < 16; b++) {
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+            }
+        }
     }
+    eeprom_stream_end(&st);
+    return crc;
 }
 
-void eeprom_write(spi_inst_t *spi, uint cs_pin, uint16_t addr, uint16_t data) {
-    cs_deselect(cs_pin);
-    // sleep_us(1);
-    cs_select(cs_pin);
+#if defined(BENCH) && defined(EEPROM_LOW_MEM)
+extern uint32_t __StackBottom; // Lowest address of the core 0 stack, from the SDK linker script
+#define STACK_PAINT 0x5EEDC0DEu
 
-    // Combine the 3-bit command, 10-bit address, and 16-bit data into a 29-bit value
-    uint32_t cmd = ((uint32_t)EEPROM_CMD_WRITE << 26) | // 3-bit command
-                   ((addr & 0x03FF) << 16) |           // 10-bit address
-                   (data & 0xFFFF);                    // 16-bit data
-// #define DEBUG
-    // Debug: Print the cmd value
-    #ifdef DEBUG
-    printf("cmd: 0x%08X\n", cmd);
-    #endif
-    // Split the 32-bit cmd into 4 bytes for SPI transmission
-    uint8_t cmdbuf[4] = {
-        (cmd >> 24) & 0xFF,
-        (cmd >> 16) & 0xFF,
-        (cmd >> 8) & 0xFF,
-        cmd & 0xFF
-    };
+/**
+ * @brief Fill the free stack below the caller with STACK_PAINT; the returned top is what stack_peak measures from
+ * @return NULL if the caller is already at or below __StackBottom (i.e. the stack has overflowed), so nothing
+ * \details could be painted and there is nothing to measure
+ */
+static uint32_t *__attribute__((noinline)) stack_paint(void) {
+    uint32_t *top = (uint32_t *)__builtin_frame_address(0) - 16; // Stay clear of this frame
+    if (top <= &__StackBottom) return NULL;
+    for (uint32_t *p = &__StackBottom; p < top; p++) *p = STACK_PAINT;
+    return top;
+}
 
-    // Debug: Print the cmdbuf values
-    #ifdef DEBUG
-    printf("cmdbuf: %02X %02X %02X %02X\n", cmdbuf[0], cmdbuf[1], cmdbuf[2], cmdbuf[3]);
-    #endif
+/// @brief Deepest stack use below top since stack_paint, in bytes; 0 if stack_paint could not paint
+static size_t stack_peak(const uint32_t *top) {
+    if (!top) return 0;
+    const uint32_t *p = &__StackBottom;
+    while (p < top && *p == STACK_PAINT) p++;
+    return (top - p) * sizeof(*p);
+}
 
-    // Perform the SPI write operation
-    spi_write_blocking(spi, cmdbuf, 4);
-    // sleep_ms(10); // Wait for the maximum write cycle time to complete
-    // sleep_ms(4); // Wait for the typical write cycle time to complete
-    sleep_ms(7); // Wait for between the typical and the maximum write cycle time to complete
-    cs_deselect(cs_pin);
-    cs_select(cs_pin); // for repeatability (so that the previous write does not affect the next write)
+static void lowmem_sum_sink(void *ctx, uint16_t addr, const uint16_t *words, size_t n) {
+    for (size_t i = 0; i < n; i++) *(uint32_t *)ctx += words[i];
 }
-void eeprom_write_buf(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, const uint16_t *buf, size_t len) {
-    for (size_t i = 0; i < len; i++) {
-        // Debug: Print the address and data being written
-        // printf("Writing to Addr: 0x%03X, Data: 0x%04X\n", start_addr + i, buf[i]);
+#endif
 
-        // Write the data to the EEPROM
-        eeprom_write(spi, cs_pin, start_addr + i, buf[i]);
-        cs_select(cs_pin);
-        // Wait for the write cycle to complete
-        // sleep_ms(5); // Ensure write cycle time is met
+#ifdef EEPROM_LOW_MEM
+static void lowmem_print_sink(void *ctx, uint16_t addr, const uint16_t *words, size_t n) {
+    for (size_t i = 0; i < n; i++, addr++) {
+        if (addr % 16 == 0) printf("\n%04X  | ", addr);
+        printf("%04X ", words[i]);
     }
 }
 
-void eeprom_erase(spi_inst_t *spi, uint cs_pin, uint16_t addr) {
-    cs_deselect(cs_pin);
-    // eeprom_write_enable(spi, cs_pin);
-    cs_select(cs_pin);
-    uint16_t cmd = (EEPROM_CMD_ERASE << 13) | ((addr & 0x03FF) << 3); // 3-bit command + 10-bit address + 3 dummy bits
-    uint8_t cmdbuf[2] = {cmd >> 8, cmd & 0xFF};
-    spi_write_blocking(spi, cmdbuf, 2);
-    cs_deselect(cs_pin);
-    // sleep_ms(7); // Wait for erase cycle to complete
-    sleep_ms(4); // wait for typical write time for the erase cycle to complete
+static void lowmem_double(void *ctx, uint16_t addr, uint16_t *words, size_t n) {
+    for (size_t i = 0; i < n; i++) words[i] *= 2; // x2 all values
 }
+#endif
 
-void eeprom_dump(spi_inst_t *spi, uint cs_pin) {
-    uint16_t data;
-    dump_flag = 1; // Set the dump flag to avoid redundant CS toggling in eeprom_read
-    printf("\nEEPROM Memory Dump:\n");
-    printf("Addr  | Data\n");
-    printf("------+-------\n");
+/* MEMORY TESTS */
+/**
+ * Incoming-inspection tests. Whole-array backgrounds go in with WRAL/ERAL (one program cycle each) and
+ * every whole-array read is one streamed sequential READ; only the march elements that need a read and
+ * a write per cell in address order pay a program cycle per word, ended by ready polling rather than the
+ * fixed 7 ms of eeprom_write. The per-word passes (four for March C-, two each for checkerboard and
+ * address) dominate the run time; the solid backgrounds take milliseconds.
+ */
+#define EEPROM_TEST_MAX_FAILS 16
+
+typedef struct {
+    uint16_t addr;
+    uint16_t expect;
+    uint16_t got;
+} eeprom_test_fail_t;
+
+typedef struct {
+    const char *name;
+    uint32_t failures;   // Every failing read, including those past the first EEPROM_TEST_MAX_FAILS
+    eeprom_test_fail_t fails[EEPROM_TEST_MAX_FAILS];
+    uint64_t us;
+} eeprom_test_result_t;
+
+typedef enum {
+    EEPROM_PATTERN_SOLID,   // arg everywhere
+    EEPROM_PATTERN_CHECKER, // arg on even words, ~arg on odd ones
+    EEPROM_PATTERN_ADDRESS, // Each word holds its own address, xor arg
+} eeprom_pattern_t;
+
+static inline uint16_t eeprom_pattern_word(eeprom_pattern_t p, uint16_t arg, uint16_t addr) {
+    switch (p) {
+    case EEPROM_PATTERN_CHECKER: return (addr & 1) ? ~arg : arg;
+    case EEPROM_PATTERN_ADDRESS: return addr ^ arg;
+    default:                     return arg;
+    }
+}
 
-    for (uint16_t addr = 0; addr <= 0x03FF; addr++) {
-        //! Handle chip select here since dump_flag is active
-        cs_deselect(cs_pin);
-        cs_select(cs_pin);
-        // Use eeprom_read to read data from the EEPROM
-        eeprom_read(spi, cs_pin, addr, &data);
+static void eeprom_test_fail(eeprom_test_result_t *r, uint16_t addr, uint16_t expect, uint16_t got) {
+    if (r->failures < EEPROM_TEST_MAX_FAILS) {
+        r->fails[r->failures] = (eeprom_test_fail_t){ addr, expect, got };
+    }
+    r->failures++;
+}
 
-        // Print the data in a formatted manner
-        if (addr % 16 == 0) {
-            printf("\n%04X  | ", addr);
+/// @brief Read the whole part in one stream and check it against the pattern
+static void eeprom_test_verify(spi_inst_t *spi, uint cs_pin, eeprom_pattern_t p, uint16_t arg, eeprom_test_result_t *r) {
+    uint16_t chunk[EEPROM_CHUNK_WORDS];
+    eeprom_stream_t st;
+
+    eeprom_stream_begin(&st, spi, cs_pin, 0);
+    for (uint16_t base = 0; base < eeprom_geom->words; base += count_of(chunk)) {
+        size_t n = MIN(count_of(chunk), eeprom_geom->words - base);
+        eeprom_stream_read(&st, chunk, n);
+        for (size_t i = 0; i < n; i++) {
+            uint16_t expect = eeprom_pattern_word(p, arg, base + i);
+            if (chunk[i] != expect) eeprom_test_fail(r, base + i, expect, chunk[i]);
         }
-        printf("%04X ", data);
     }
+    eeprom_stream_end(&st);
+}
 
-    printf("\n");
-    dump_flag = 0; // Reset the dump flag
+/// @brief Program the pattern word by word (WRAL when it is solid), then verify it
+static void eeprom_test_fill(spi_inst_t *spi, uint cs_pin, eeprom_pattern_t p, uint16_t arg, eeprom_test_result_t *r) {
+    if (p == EEPROM_PATTERN_SOLID) {
+        bool ok = (arg == 0xFFFF) ? eeprom_erase_all(spi, cs_pin) : eeprom_write_all(spi, cs_pin, arg);
+        if (!ok) eeprom_test_fail(r, 0, arg, 0);
+    } else {
+        for (uint16_t a = 0; a < eeprom_geom->words; a++) {
+            eeprom_write_start(spi, cs_pin, a, eeprom_pattern_word(p, arg, a));
+            if (!eeprom_wait_ready(cs_pin, EEPROM_TWP_MAX_US)) eeprom_test_fail(r, a, eeprom_pattern_word(p, arg, a), 0);
+        }
+    }
+    eeprom_test_verify(spi, cs_pin, p, arg, r);
 }
-void eeprom_copy(spi_inst_t *spi, uint cs_pin, uint16_t* eeprom_buffer) {
-    uint16_t data;
-    dump_flag = 1; // Set the dump flag to avoid redundant CS toggling in eeprom_read
 
-    for (uint16_t addr = 0; addr <= 0x03FF; addr++) {
-        //! Handle chip select here since dump_flag is active
-        cs_deselect(cs_pin);
-        cs_select(cs_pin);
-        // Use eeprom_read to read data from the EEPROM
-        eeprom_read(spi, cs_pin, addr, &data);
-        eeprom_buffer[addr] = data;
-        // Print the data in a formatted manner
-        // if (addr % 16 == 0) {
-        //     printf("\n%04X  | ", addr);
-        // }
-        // printf("%04X ", data);
+/// @brief Solid backgrounds 0x0000, 0xFFFF, 0x5555, 0xAAAA: four program cycles and four streamed reads
+void eeprom_test_solid(spi_inst_t *spi, uint cs_pin, eeprom_test_result_t *r) {
+    static const uint16_t backgrounds[] = {0x0000, 0xFFFF, 0x5555, 0xAAAA};
+    for (size_t i = 0; i < count_of(backgrounds); i++) {
+        eeprom_test_fill(spi, cs_pin, EEPROM_PATTERN_SOLID, backgrounds[i], r);
     }
+}
 
-    // printf("\n");
-    dump_flag = 0; // Reset the dump flag
-    printf("EEPROM Memory Saved to buffer\r\n");
+/// @brief Word checkerboard and its inverse (every bit differs from both neighbours)
+void eeprom_test_checkerboard(spi_inst_t *spi, uint cs_pin, eeprom_test_result_t *r) {
+    eeprom_test_fill(spi, cs_pin, EEPROM_PATTERN_CHECKER, 0x5555, r);
+    eeprom_test_fill(spi, cs_pin, EEPROM_PATTERN_CHECKER, 0xAAAA, r);
 }
 
-void eeprom_paste(spi_inst_t *spi, uint cs_pin, const uint16_t* eeprom_buffer) {
-    for (uint16_t addr = 0; addr <= 0x03FF; addr++) {
-        // Write data from buffer to EEPROM
-        eeprom_write(spi, cs_pin, addr, eeprom_buffer[addr]);
-    }
-    
-    printf("Buffer contents written to EEPROM\r\n");
+/// @brief Address-in-address (as TEST_ALL) and its complement, which catches shorted or stuck address lines
+void eeprom_test_address(spi_inst_t *spi, uint cs_pin, eeprom_test_result_t *r) {
+    eeprom_test_fill(spi, cs_pin, EEPROM_PATTERN_ADDRESS, 0x0000, r);
+    eeprom_test_fill(spi, cs_pin, EEPROM_PATTERN_ADDRESS, 0xFFFF, r);
 }
 
-/*
-Usage: const char *message = "Hello, EEPROM!";
-       eeprom_write_string(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x100, message);
-*/
-void eeprom_write_string(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, const char *str) {
-    uint16_t word;
-    size_t i = 0;
+/// @brief One march element: for each cell in order, read and check expect, then write data
+static void eeprom_march_element(spi_inst_t *spi, uint cs_pin, bool up, uint16_t expect, uint16_t data, eeprom_test_result_t *r) {
+    for (uint16_t i = 0; i < eeprom_geom->words; i++) {
+        uint16_t a = up ? i : eeprom_geom->addr_mask - i;
+        uint16_t got;
+        eeprom_read(spi, cs_pin, a, &got);
+        if (got != expect) eeprom_test_fail(r, a, expect, got);
+        eeprom_write_start(spi, cs_pin, a, data);
+        if (!eeprom_wait_ready(cs_pin, EEPROM_TWP_MAX_US)) eeprom_test_fail(r, a, data, 0);
+    }
+}
 
-    while (str[i] != '\0') {
-        // Combine two characters into a 16-bit word (big-endian)
-        word = (str[i] << 8) | (str[i + 1] != '\0' ? str[i + 1] : 0);
-        eeprom_write(spi, cs_pin, start_addr++, word);
+/**
+ * @brief March C-: {(w0); up(r0,w1); up(r1,w0); down(r0,w1); down(r1,w0); (r0)} with 0 = 0x0000, 1 = 0xFFFF
+ * @details The first and last elements have no ordering constraint and run as WRAL and a streamed read.
+ * \details The middle four must read each cell after the previous cell was written, so they go word by word.
+ */
+void eeprom_test_march_c(spi_inst_t *spi, uint cs_pin, eeprom_test_result_t *r) {
+    if (!eeprom_write_all(spi, cs_pin, 0x0000)) eeprom_test_fail(r, 0, 0x0000, 0);
+    eeprom_march_element(spi, cs_pin, true, 0x0000, 0xFFFF, r);
+    eeprom_march_element(spi, cs_pin, true, 0xFFFF, 0x0000, r);
+    eeprom_march_element(spi, cs_pin, false, 0x0000, 0xFFFF, r);
+    eeprom_march_element(spi, cs_pin, false, 0xFFFF, 0x0000, r);
+    eeprom_test_verify(spi, cs_pin, EEPROM_PATTERN_SOLID, 0x0000, r);
+}
 
-        // Move to the next pair of characters
-        i += 2;
+/**
+ * @brief Run every test on the part and print the failing cells and the time each took
+ * @note Destroys the contents of the whole part. Leaves programming enabled.
+ * @return the total number of failures
+ */
+uint32_t eeprom_qualify(spi_inst_t *spi, uint cs_pin) {
+    static void (*const tests[])(spi_inst_t *, uint, eeprom_test_result_t *) = {
+        eeprom_test_solid, eeprom_test_checkerboard, eeprom_test_address, eeprom_test_march_c,
+    };
+    static const char *names[] = {"solid", "checkerboard", "address", "march C-"};
+    eeprom_test_result_t r;
+    uint32_t total = 0;
+    uint64_t t_all = time_us_64();
+
+    eeprom_write_enable(spi, cs_pin);
+    for (size_t t = 0; t < count_of(tests); t++) {
+        r = (eeprom_test_result_t){ .name = names[t] };
+        uint64_t t0 = time_us_64();
+        tests[t](spi, cs_pin, &r);
+        r.us = time_us_64() - t0;
+        total += r.failures;
+
+        printf("%-12s %s, %llu ms", r.name, r.failures ? "FAIL" : "pass", r.us / 1000);
+        if (r.failures) printf(", %lu failures", r.failures);
+        printf("\n");
+        for (uint32_t i = 0; i < MIN(r.failures, EEPROM_TEST_MAX_FAILS); i++) {
+            printf("    0x%03X: expected 0x%04X, read 0x%04X\n", r.fails[i].addr, r.fails[i].expect, r.fails[i].got);
+        }
     }
+    printf("Qualification %s in %llu ms\n", total ? "FAILED" : "passed", (time_us_64() - t_all) / 1000);
+    return total;
 }
 
-void eeprom_read_string(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, char *str, size_t max_len) {
-    uint16_t word;
-    size_t i = 0;
+#ifdef EEPROM_WEAR_TRACK
+/* WEAR TRACKING */
+#ifndef EEPROM_WEAR_BASE
+#define EEPROM_WEAR_BASE        0x180 // One word per block reserved for the stored counters
+#endif
+#define EEPROM_WEAR_UNIT        16    // Stored counters count this many program cycles
+#define EEPROM_WEAR_FLUSH_EVERY 1024  // Program cycles between automatic flushes
 
-    while (i < max_len - 1) { // Reserve space for the null terminator
-        // Read a 16-bit word from the EEPROM
-        eeprom_read(spi, cs_pin, start_addr++, &word);
+typedef struct {
+    uint16_t addr;   // First word of the block
+    uint32_t writes;
+} eeprom_wear_entry_t;
 
-        // Extract the two characters from the 16-bit word (big-endian)
-        str[i++] = (char)(word >> 8); // High byte
-        if (i < max_len - 1) {
-            str[i++] = (char)(word & 0xFF); // Low byte
-        }
+/**
+ * @brief Start tracking the part on cs_pin, resuming from the counters stored in the reserved region
+ * @details One sequential READ. Unwritten counters (0xFFFF) start at 0. The block count follows the
+ * \details geometry in use (see eeprom_probe), so probe first.
+ * @return false, and nothing is tracked, if the reserved region does not fit in the part
+ */
+bool eeprom_wear_load(spi_inst_t *spi, uint cs_pin) {
+    uint16_t stored[EEPROM_WEAR_BLOCKS];
+    size_t blocks = eeprom_geom->words / EEPROM_WEAR_BLOCK_WORDS;
 
-        // Stop if a null terminator is encountered
-        if ((char)(word >> 8) == '\0' || (char)(word & 0xFF) == '\0') {
-            break;
-        }
+    eeprom_wear.cs_pin = -1;
+    if (EEPROM_WEAR_BASE + blocks > eeprom_geom->words) return false;
+
+    eeprom_sequential_read_length(spi, cs_pin, EEPROM_WEAR_BASE, stored, blocks);
+    for (size_t b = 0; b < blocks; b++) {
+        eeprom_wear.writes[b] = (stored[b] == 0xFFFF) ? 0 : (uint32_t)stored[b] * EEPROM_WEAR_UNIT;
     }
+    eeprom_wear.blocks = blocks;
+    eeprom_wear.since_flush = 0;
+    eeprom_wear.cs_pin = cs_pin;
+    return true;
+}
 
-    // Ensure the string is null-terminated
-    str[i] = '\0';
+/**
+ * @brief Store the counters, in units of EEPROM_WEAR_UNIT rounded up
+ * @details Rounding up means a reset can only over-count, by less than one unit per block, which is the
+ * \details safe side for an endurance budget. Between flushes a counter rarely crosses a unit boundary, so
+ * \details the diff-aware update usually programs only a handful of words.
+ * @return the number of words programmed, or -1 if a write timed out
+ */
+int eeprom_wear_flush(spi_inst_t *spi, uint cs_pin) {
+    uint16_t stored[EEPROM_WEAR_BLOCKS];
+
+    for (size_t b = 0; b < eeprom_wear.blocks; b++) {
+        stored[b] = MIN((eeprom_wear.writes[b] + EEPROM_WEAR_UNIT - 1) / EEPROM_WEAR_UNIT, 0xFFFE);
+    }
+    eeprom_wear.since_flush = 0;
+    return eeprom_update_buf(spi, cs_pin, EEPROM_WEAR_BASE, stored, eeprom_wear.blocks);
 }
 
-void print_buffer(uint16_t eeprom_buffer[0x400]) {
-    for(int i = 0; i < 0x400; i++) {
-        // Print the data in a formatted manner
-        if (i % 16 == 0) {
-            printf("\n%04X  | ", i);
+/// @brief Flush once EEPROM_WEAR_FLUSH_EVERY program cycles have been counted since the last one
+int eeprom_wear_maybe_flush(spi_inst_t *spi, uint cs_pin) {
+    return (eeprom_wear.since_flush >= EEPROM_WEAR_FLUSH_EVERY) ? eeprom_wear_flush(spi, cs_pin) : 0;
+}
+
+/**
+ * @brief The n most-written blocks, hottest first
+ * @return the number of entries filled (at most n)
+ */
+size_t eeprom_wear_hottest(eeprom_wear_entry_t *out, size_t n) {
+    size_t filled = 0;
+
+    for (size_t b = 0; b < eeprom_wear.blocks; b++) {
+        eeprom_wear_entry_t e = { b * EEPROM_WEAR_BLOCK_WORDS, eeprom_wear.writes[b] };
+        if (e.writes == 0) continue;
+        // Insertion into the sorted top-n
+        size_t i = (filled < n) ? filled++ : n;
+        while (i > 0 && out[i - 1].writes < e.writes) {
+            if (i < n) out[i] = out[i - 1];
+            i--;
         }
-        printf("%04X ", eeprom_buffer[i]);
+        if (i < n) out[i] = e;
     }
+    return filled;
 }
+#endif
 
-/* NON-WORKING FUNCTIONS */
-void eeprom_sequential_read_length(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, uint16_t *buf, size_t length) {
-    if (length == 0) return;
+/* VOTED READS */
+#define EEPROM_VOTE_CHUNK      16       // Words per voted chunk: a disagreement only costs re-reading this many
+#define EEPROM_VOTE_STEP_AFTER 3        // Disagreeing chunks before the clock is stepped down
+#define EEPROM_VOTE_MIN_BAUD   250000
 
-    cs_deselect(cs_pin);
-    delay_250ns();
-    // Ensure CS pin is high for the entire transaction
-    cs_select(cs_pin);
+/**
+ * @brief Health of voted reads; disagreements are what drive the clock step-down
+ */
+typedef struct {
+    uint32_t chunks;
+    uint32_t disagreements;  // Chunks where the reads did not all agree
+    uint32_t corrected;      // Words where the vote overruled at least one read
+    uint32_t step_downs;
+    uint32_t since_step;
+} eeprom_vote_stats_t;
 
-    // Construct the read command for the first address
-    uint16_t cmd = (EEPROM_CMD_READ << 10) | (start_addr & 0x03FF);
-    uint8_t cmdbuf[2] = {cmd >> 8, cmd & 0xFF};
+static eeprom_vote_stats_t eeprom_vote_stats;
 
-    // Send the read command
-    spi_write_blocking(spi, cmdbuf, 2);
+/**
+ * @brief Read length words, each one taken at least twice and settled by a bitwise majority of three
+ * @details Every chunk is streamed votes times (2 or 3). With 2, a third read is only issued for a chunk
+ * \details whose two reads disagree, so a clean bus costs twice the bus time and no more. Each
+ * \details EEPROM_VOTE_STEP_AFTER disagreeing chunks, SCK is stepped down by a quarter (not below
+ * \details EEPROM_VOTE_MIN_BAUD), so the bus can start near its limit and back off by itself.
+ * \details The streamed path is used rather than DMA: chunks are short and the words are compared on the fly.
+ * \details The step-down reprograms the PL022 directly; on a shared bus use eeprom_bus_read_voted instead.
+ * @return the number of chunks that needed the vote
+ */
+int eeprom_read_voted(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, uint16_t *buf, size_t length, uint votes) {
+    uint16_t v[2][EEPROM_VOTE_CHUNK];
+    int voted = 0;
+
+    for (size_t done = 0; done < length; done += EEPROM_VOTE_CHUNK) {
+        size_t m = MIN(length - done, EEPROM_VOTE_CHUNK);
+        uint16_t addr = start_addr + done;
+        uint16_t *a = buf + done;
+
+        eeprom_sequential_read_length(spi, cs_pin, addr, a, m);
+        eeprom_sequential_read_length(spi, cs_pin, addr, v[0], m);
+        bool agree = (memcmp(a, v[0], m * sizeof(*a)) == 0);
+        eeprom_vote_stats.chunks++;
+        if (agree && votes < 3) continue;
+
+        eeprom_sequential_read_length(spi, cs_pin, addr, v[1], m);
+        for (size_t i = 0; i < m; i++) {
+            uint16_t maj = (a[i] & v[0][i]) | (a[i] & v[1][i]) | (v[0][i] & v[1][i]);
+            if (a[i] != maj || v[0][i] != maj || v[1][i] != maj) {
+                agree = false;
+                eeprom_vote_stats.corrected++;
+            }
+            a[i] = maj;
+        }
+        if (agree) continue;
+
+        voted++;
+        eeprom_vote_stats.disagreements++;
+        if (++eeprom_vote_stats.since_step >= EEPROM_VOTE_STEP_AFTER) {
+            uint baud = spi_get_baudrate(spi);
+            if (baud > EEPROM_VOTE_MIN_BAUD) {
+                spi_set_baudrate(spi, MAX(baud - baud / 4, EEPROM_VOTE_MIN_BAUD));
+                eeprom_vote_stats.step_downs++;
+            }
+            eeprom_vote_stats.since_step = 0;
+        }
+    }
+    return voted;
+}
 
-    // Allocate a buffer for the entire read operation
-    uint8_t databuf[3 + (length - 1) * 2]; // First read (3 bytes) + subsequent reads (2 bytes each)
+/**
+ * @brief eeprom_read_voted on a shared bus
+ * @details A step-down is written back to the device and to the bus cache, so the EEPROM keeps its backed-off
+ * \details clock on later transactions and the next device to acquire the bus gets its own rate reprogrammed.
+ */
+int eeprom_bus_read_voted(spi_bus_t *bus, spi_device_t *dev, uint16_t start_addr, uint16_t *buf, size_t length, uint votes) {
+    spi_bus_acquire(bus, dev);
+    uint before = spi_get_baudrate(bus->spi);
+    int voted = eeprom_read_voted(bus->spi, dev->cs_pin, start_addr, buf, length, votes);
+    uint baud = spi_get_baudrate(bus->spi);
+    if (baud != before) {
+        dev->baud = baud;
+        bus->baud = baud;
+    }
+    spi_bus_release(bus);
+    return voted;
+}
 
-    // Perform a single SPI read for all data
-    spi_read_blocking(spi, 0, databuf, sizeof(databuf));
+/* FAST BOOT */
+#ifndef EEPROM_BOOT_CFG_BASE
+#define EEPROM_BOOT_CFG_BASE  0x260 // Config region (header, field table and data) read at boot
+#endif
+#ifndef EEPROM_BOOT_CFG_WORDS
+#define EEPROM_BOOT_CFG_WORDS 0x60
+#endif
 
-    // Handle the first read (with dummy bit)
-    buf[0] = ((uint16_t)(databuf[0] << 9)) | ((uint16_t)(databuf[1] << 1)) | ((databuf[2] >> 7) & 0x01);
+uint16_t eeprom_boot_cfg[EEPROM_BOOT_CFG_WORDS];
+uint64_t eeprom_boot_cfg_ready_us; // Microseconds from reset until eeprom_boot_cfg was valid
 
-    // Handle subsequent reads (16 bits each)
-    for (size_t i = 1; i < length; i++) {
-        buf[i] = ((uint16_t)(databuf[3 + (i - 1) * 2] << 8)) | (databuf[3 + (i - 1) * 2 + 1]<<1)&0xFF | (databuf[3 + (i - 1) * 2 + 1]>>7)&0x01;
-        // buf[i] <<= 1;
-        // buf[i] >>=7;
-    }
+/**
+ * @brief Bring up spi_default on the board's default SPI pins, and the CS line for the part
+ * @details Needs nothing else initialised first. Only the default instance and pins are supported: they are
+ * \details the ones muxed here, and EEPROM_DO_PIN (READY/BUSY polling) is the default RX pin.
+ */
+void eeprom_spi_init(uint baud, uint cs_pin) {
+    spi_init(spi_default, baud);
+    spi_set_format(spi_default, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST); //< SPI Mode 0
+    gpio_set_function(PICO_DEFAULT_SPI_RX_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(PICO_DEFAULT_SPI_SCK_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(PICO_DEFAULT_SPI_TX_PIN, GPIO_FUNC_SPI);
 
-    // Ensure CS pin is low after the transaction
+    gpio_init(cs_pin);
+    gpio_set_dir(cs_pin, GPIO_OUT);
     cs_deselect(cs_pin);
 }
-void eeprom_sequential_read_range(spi_inst_t *spi, uint cs_pin, uint16_t start_addr, uint16_t end_addr, uint16_t *buf) {
-    if (start_addr > end_addr) return;
 
-    size_t length = end_addr - start_addr + 1;
+/**
+ * @brief Load the config block as the very first thing after reset
+ * @details Call before stdio_init_all(): USB enumeration and the console come afterwards. The block is one
+ * \details DMA'd sequential READ (24 + 16 * EEPROM_BOOT_CFG_WORDS SK periods, about 1.6 ms at 1 MHz for
+ * \details the default 0x60 words). The timer starts counting at reset, so time_us_64() here is the
+ * \details reset-to-ready time itself. Uses spi_default on its default pins (see eeprom_spi_init).
+ */
+void eeprom_fast_boot(uint baud, uint cs_pin) {
+    eeprom_spi_init(baud, cs_pin);
+    eeprom_read_bulk(spi_default, cs_pin, EEPROM_BOOT_CFG_BASE, eeprom_boot_cfg, EEPROM_BOOT_CFG_WORDS);
+    eeprom_boot_cfg_ready_us = time_us_64();
+}
+
+#ifdef FUZZ
+#define EEPROM_FUZZ_BASE  0x3C0 // Window the fuzzer may program (keeps wear off the rest of the part)
+#define EEPROM_FUZZ_WORDS 0x40
 
-    cs_deselect(cs_pin);
-    delay_250ns();
-    // Ensure CS pin is low for the entire transaction
-    cs_select(cs_pin);
+static uint16_t eeprom_model[0x400]; // Reference memory model: what the part should contain
 
-    // Construct the read command for the first address
-    uint16_t cmd = (EEPROM_CMD_READ << 10) | (start_addr & 0x03FF);
-    uint8_t cmdbuf[2] = {cmd >> 8, cmd & 0xFF};
-    uint8_t databuf[3 + (length - 1) * 2]; // Buffer for the first read (3 bytes) + subsequent reads (2 bytes each)
+static inline uint32_t fuzz_rand(uint32_t *state) {
+    // xorshift32, so a failing seed reproduces exactly
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
 
-    // Send the read command
-    spi_write_blocking(spi, cmdbuf, 2);
+static uint16_t fuzz_data(uint32_t *state) {
+    // Bias towards the patterns that have caught the bit packing out before (e.g. ABCD read back as ABCC)
+    static const uint16_t edge[] = {0x0000, 0xFFFF, 0xABCD, 0xDCBA, 0x8000, 0x0001, 0xAAAA, 0x5555};
+    uint32_t r = fuzz_rand(state);
+    return (r & 0x3) ? (uint16_t)(r >> 16) : edge[(r >> 2) % count_of(edge)];
+}
 
-    // Read all the data in one SPI transaction
-    spi_read_blocking(spi, 0, databuf, sizeof(databuf));
+static uint16_t fuzz_addr(uint32_t *state) {
+    uint32_t r = fuzz_rand(state);
+    uint16_t addr = EEPROM_FUZZ_BASE + (r % EEPROM_FUZZ_WORDS);
+    // Occasionally set address bits above A9: the part must wrap them (0x400 -> 0x000)
+    return (r & 0x80000000u) ? (addr | 0x400) : addr;
+}
+
+static int fuzz_check(const char *op, uint32_t seed, uint32_t step, uint16_t addr, uint16_t expect, uint16_t got) {
+    if (expect == got) return 0;
+    printf("FUZZ mismatch seed=0x%08lX step=%lu op=%s addr=0x%03X expect=0x%04X got=0x%04X\n",
+           seed, step, op, addr & 0x3FF, expect, got);
+    return 1;
+}
 
-    // Handle the first read (with dummy bit)
-    buf[0] = ((uint16_t)(databuf[0] << 9)) | ((uint16_t)(databuf[1] << 1)) | ((databuf[2] >> 7) & 0x01);
+/**
+ * @brief Differential fuzzing of the driver against a reference memory model
+ * @details Random sequences of WRITE, ERASE, READ, write_buf and sequential reads are driven through the
+ * \details real driver and every word read back is compared bit-for-bit with eeprom_model. Runs on target
+ * \details (there is no host build to hang libFuzzer off); the seed of a failing run reproduces it.
+ * @return number of mismatching words
+ */
+int eeprom_fuzz(spi_inst_t *spi, uint cs_pin, uint32_t iterations, uint32_t seed) {
+    uint32_t state = seed ? seed : 1;
+    uint16_t buf[8];
+    uint16_t data;
+    int errors = 0;
 
-    // Handle subsequent reads (16 bits each)
-    for (size_t i = 1; i < length; i++) {
-        buf[i] = ((uint16_t)(databuf[3 + (i - 1) * 2] << 8)) | databuf[3 + (i - 1) * 2 + 1];
-        // buf[i] <<= 1;
+    // Trust single-word reads to seed the model for the window
+    for (uint16_t a = EEPROM_FUZZ_BASE; a < EEPROM_FUZZ_BASE + EEPROM_FUZZ_WORDS; a++) {
+        eeprom_read(spi, cs_pin, a, &eeprom_model[a]);
     }
 
-    // Ensure CS pin is high after the transaction
-    cs_deselect(cs_pin);
+    for (uint32_t step = 0; step < iterations; step++) {
+        uint16_t addr = fuzz_addr(&state);
+        uint16_t a = addr & 0x3FF;
+        size_t len = 1 + (fuzz_rand(&state) % count_of(buf));
+        if (a + len > EEPROM_FUZZ_BASE + EEPROM_FUZZ_WORDS) len = EEPROM_FUZZ_BASE + EEPROM_FUZZ_WORDS - a;
+
+        switch (fuzz_rand(&state) % 5) {
+        case 0:
+            data = fuzz_data(&state);
+            eeprom_write(spi, cs_pin, addr, data);
+            eeprom_model[a] = data;
+            break;
+        case 1:
+            eeprom_erase(spi, cs_pin, addr);
+            eeprom_model[a] = 0xFFFF;
+            break;
+        case 2:
+            eeprom_read(spi, cs_pin, addr, &data);
+            errors += fuzz_check("read", seed, step, a, eeprom_model[a], data);
+            break;
+        case 3:
+            for (size_t i = 0; i < len; i++) {
+                buf[i] = fuzz_data(&state);
+                eeprom_model[a + i] = buf[i];
+            }
+            eeprom_write_buf(spi, cs_pin, a, buf, len);
+            break;
+        case 4:
+            eeprom_sequential_read_length(spi, cs_pin, a, buf, len);
+            for (size_t i = 0; i < len; i++) {
+                errors += fuzz_check("seq_read", seed, step, a + i, eeprom_model[a + i], buf[i]);
+            }
+            break;
+        }
+    }
+    return errors;
 }
+#endif
 
 int main() {
+    // Config first: nothing before this touches USB or the console
+    eeprom_fast_boot(1000 * 1000, PICO_DEFAULT_SPI_CSN_PIN);
+
     stdio_init_all();
     sleep_ms(5000);
 
     printf("\nEEPROM example\n");
+    printf("Config ready %llu us after reset (%u words from 0x%03X)\n", eeprom_boot_cfg_ready_us,
+           EEPROM_BOOT_CFG_WORDS, EEPROM_BOOT_CFG_BASE);
 
     //#define TP 14 // KB0
     #ifdef TP
@@ -359,22 +2786,26 @@ int main() {
     gpio_put(TP,0);
     #endif
 
-    spi_init(spi_default, 1000 * 1000);
+    // SPI and CS were brought up by eeprom_fast_boot() at 1 MHz
     // spi_init(spi_default, 500 * 1000);
     // spi_init(spi_default, 250 * 1000);
     // spi_set_format(spi_default, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST); //< SPI Mode 0
     // spi_set_format(spi_default, 16, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST); //< SPI Mode 3
-    spi_set_format(spi_default, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST); //< SPI Mode 0
     // spi_set_format(spi_default, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST); //< SPI Mode 3
-    gpio_set_function(PICO_DEFAULT_SPI_RX_PIN, GPIO_FUNC_SPI);
-    gpio_set_function(PICO_DEFAULT_SPI_SCK_PIN, GPIO_FUNC_SPI);
-    gpio_set_function(PICO_DEFAULT_SPI_TX_PIN, GPIO_FUNC_SPI);
 
-    gpio_init(PICO_DEFAULT_SPI_CSN_PIN);
-    gpio_set_dir(PICO_DEFAULT_SPI_CSN_PIN, GPIO_OUT);
-    gpio_put(PICO_DEFAULT_SPI_CSN_PIN, 1);
+    const eeprom_geometry_t *geom;
+    static const char *probe_names[] = { "absent", "faulty", "ok", "ambiguous" };
+    eeprom_probe_status_t probe = eeprom_probe(PICO_DEFAULT_SPI_SCK_PIN, PICO_DEFAULT_SPI_TX_PIN, EEPROM_DO_PIN,
+                                               PICO_DEFAULT_SPI_CSN_PIN, false, &geom);
+    printf("Probe: %s%s%s\n", probe_names[probe], geom ? ", " : "", geom ? geom->name : "");
+    if (geom && geom->word_bits != 16) {
+        printf("x8 organisation (ORG low) is not supported by the word driver\n");
+    }
 
     eeprom_write_enable(spi_default, PICO_DEFAULT_SPI_CSN_PIN);
+    #ifdef EEPROM_WEAR_TRACK
+    if (!eeprom_wear_load(spi_default, PICO_DEFAULT_SPI_CSN_PIN)) printf("Wear tracking: part too small\n");
+    #endif
     /// @note Once in the EWEN state, programming remains enabled until an EWDS instruction is executed 
     ///\ or VCC power is removed from the part.
 
@@ -433,6 +2864,11 @@ int main() {
     eeprom_read(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x0FF, &data);
     printf("Read data at 0x0FF: %d\n", data);
     
+    #ifdef QUALIFY
+    puts("\nQualification:");
+    eeprom_qualify(spi_default, PICO_DEFAULT_SPI_CSN_PIN);
+    #endif
+
     #define TEST_ALL
     #ifdef TEST_ALL
     for(int i=0; i<=0x3FF; i++) {
@@ -492,13 +2928,13 @@ int main() {
 
     // char* str = "HELLO";
     // char* read_str;
-    char read_str[5];
-    char str[5] = {'H', 'i', ' ', 'N', 'C'};
+    char read_str[8];
+    char str[] = "Hi NC";
     printf("Sending %s\t", str);
     #ifdef WRITE
     eeprom_write_string(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x300, str);
     #endif
-    eeprom_read_string(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x300, read_str, 8); //max_len=8
+    eeprom_read_string(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x300, read_str, sizeof(read_str));
     printf("Read string @ 0x300+: %s\n", read_str);
 
     char* str_lit = "Hello World";
@@ -508,9 +2944,60 @@ int main() {
     #ifdef WRITE
     eeprom_write_string(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x400, str_lit);
     #endif
-    eeprom_read_string(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x400, read_str2, 15); //max_len=15
+    eeprom_read_string(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x400, read_str2, sizeof(read_str2));
     printf("Read string @ 0x400+: %s\n", read_str2);
 
+    // Typed record at 0x2C0: changing one field programs only its words
+    {
+        typedef struct {
+            uint16_t gain;
+            int16_t  offset;
+            uint32_t serial;
+        } cal_t;
+        EEPROM_RECORD(cal, cal_t, 0x2C0);
+
+        eeprom_record_load(spi_default, PICO_DEFAULT_SPI_CSN_PIN, &cal);
+        printf("Calibration: gain %u, offset %d, serial %lu\n", EEPROM_RECORD_VIEW(cal)->gain,
+               EEPROM_RECORD_VIEW(cal)->offset, EEPROM_RECORD_VIEW(cal)->serial);
+        #ifdef WRITE
+        EEPROM_RECORD_SET(cal, offset, EEPROM_RECORD_VIEW(cal)->offset + 1);
+        printf("Calibration offset bumped: %d words programmed\n", eeprom_record_flush(spi_default, PICO_DEFAULT_SPI_CSN_PIN, &cal));
+        #endif
+    }
+
+    #ifdef WRITE
+    // Config region at 0x260: after a firmware upgrade only the fields that moved get rewritten
+    {
+        enum { CFG_BAUD = 1, CFG_TRIM = 2, CFG_NAME = 3 };
+        static const eeprom_cfg_field_t schema[] = {
+            { CFG_BAUD, 2, EEPROM_CFG_DATA_START + 0, 1, NULL },
+            { CFG_TRIM, 1, EEPROM_CFG_DATA_START + 2, 1, NULL },
+            { CFG_NAME, 4, EEPROM_CFG_DATA_START + 3, 1, NULL },
+        };
+        eeprom_cfg_t cfg;
+        uint16_t baud[2];
+
+        if (eeprom_cfg_open(&cfg, spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x260, schema, count_of(schema), 1) &&
+            eeprom_cfg_get(&cfg, CFG_BAUD, baud) > 0) {
+            printf("Config v%u: baud %lu\n", cfg.header[1], ((uint32_t)baud[0] << 16) | baud[1]);
+        }
+    }
+    #endif
+
+    // String table at 0x340: a rename only programs the words of that label
+    {
+        static const char *labels[] = {"Channel A", "Channel B", "Gain", "Offset"};
+        char label[24];
+        #ifdef WRITE
+        int programmed = eeprom_strtab_write(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x340, labels, count_of(labels));
+        printf("String table: %d words programmed\n", programmed);
+        #endif
+        for (size_t i = 0; i < count_of(labels); i++) {
+            eeprom_strtab_get(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x340, i, label, sizeof(label));
+            printf("Label %u: %s\n", i, label);
+        }
+    }
+
     uint16_t buffer[10];
     uint16_t start_addr = 0x101;
 
@@ -554,7 +3041,263 @@ int main() {
     }
     #endif
 
+    #ifdef FUZZ
+    {
+        uint32_t fuzz_seed = time_us_32();
+        int fuzz_errors = eeprom_fuzz(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 2000, fuzz_seed);
+        printf("\nFuzz seed 0x%08lX: %d mismatches\n", fuzz_seed, fuzz_errors);
+    }
+    #endif
+
+    #ifdef BENCH
+    /**
+     * Gang programming: aggregate write throughput vs. chip count for each scheduling strategy.
+     * Chips share SK/DI/DO with the default chip and each have their own CS (active high).
+     */
+    {
+        static const uint gang_cs[] = EEPROM_GANG_CS_PINS;
+        const size_t gang_words = 16;
+        static const char *sched_names[] = {"sequential", "lockstep", "polled"};
+        uint16_t gang_buf[16];
+        uint present_cs[count_of(gang_cs)];
+
+        for (size_t c = 0; c < count_of(gang_cs); c++) {
+            gpio_init(gang_cs[c]);
+            gpio_set_dir(gang_cs[c], GPIO_OUT);
+            gpio_put(gang_cs[c], 0);
+        }
+
+        // Only dispatch to sockets that answer, so empty ones don't cost a tWP timeout each
+        uint64_t t0 = time_us_64();
+        eeprom_scan_t map = eeprom_scan(PICO_DEFAULT_SPI_SCK_PIN, PICO_DEFAULT_SPI_TX_PIN, EEPROM_DO_PIN, gang_cs, count_of(gang_cs));
+        uint64_t scan_us = time_us_64() - t0;
+        printf("\nScan (%llu us): populated 0x%04X, empty 0x%04X, faulty 0x%04X\n", scan_us, map.populated, map.empty, map.faulty);
+        size_t n_present = eeprom_scan_select(&map, gang_cs, count_of(gang_cs), present_cs);
+        for (size_t c = 0; c < n_present; c++) {
+            eeprom_write_enable(spi_default, present_cs[c]);
+        }
+        for (size_t i = 0; i < gang_words; i++) gang_buf[i] = 0x6000 + i;
+
+        puts("\nGang write throughput (words/s):");
+        printf("chips | %-10s | %-10s | %-10s\n", sched_names[0], sched_names[1], sched_names[2]);
+        for (size_t n = 1; n <= n_present; n++) {
+            printf("%5u", n);
+            for (int sched = EEPROM_SCHED_SEQUENTIAL; sched <= EEPROM_SCHED_POLLED; sched++) {
+                uint64_t t0 = time_us_64();
+                bool ok = eeprom_gang_write_buf(spi_default, present_cs, n, 0x380, gang_buf, gang_words, sched);
+                uint64_t us = time_us_64() - t0;
+                printf(" | %8llu%s", ok ? (n * gang_words * 1000000ull) / us : 0ull, ok ? "  " : " !");
+            }
+            printf("\n");
+        }
+    }
+    {
+        // Gang programming across engines: one chip per engine, throughput vs. engine count
+        static const uint pool_cs[] = EEPROM_POOL_CS_PINS;
+        static eeprom_pool_t pool;
+        eeprom_job_t jobs[count_of(pool_cs)];
+        uint16_t pool_buf[32];
+
+        eeprom_pool_add_spi(&pool, spi_default, PICO_DEFAULT_SPI_SCK_PIN, PICO_DEFAULT_SPI_TX_PIN, PICO_DEFAULT_SPI_RX_PIN, 1000 * 1000);
+        eeprom_pool_add_spi(&pool, spi1, EEPROM_SPI1_SCK_PIN, EEPROM_SPI1_TX_PIN, EEPROM_SPI1_RX_PIN, 1000 * 1000);
+        eeprom_pool_add_pio(&pool, pio0, EEPROM_PIO_SCK_PIN, EEPROM_PIO_DI_PIN, EEPROM_PIO_DO_PIN, 1000 * 1000);
+        for (size_t i = 0; i < count_of(pool_buf); i++) pool_buf[i] = 0x9000 + i;
+        for (size_t e = 0; e < count_of(pool_cs); e++) {
+            jobs[e] = (eeprom_job_t){ .chip = eeprom_pool_add_chip(&pool, e, pool_cs[e]), .start_addr = 0x3A0,
+                                      .buf = pool_buf, .len = count_of(pool_buf) };
+            eeprom_chip_write_enable(&pool, jobs[e].chip);
+        }
+
+        puts("\nPool write throughput (words/s):");
+        for (size_t n = 1; n <= count_of(pool_cs); n++) {
+            uint64_t t0 = time_us_64();
+            bool ok = eeprom_pool_run(&pool, jobs, n);
+            uint64_t us = time_us_64() - t0;
+            printf("%u engine(s): %llu%s\n", n, ok ? (n * count_of(pool_buf) * 1000000ull) / us : 0ull, ok ? "" : " (timeout)");
+        }
+
+        // Heterogeneous batch: full writes piled on engine 0, a mostly-unchanged diff on engine 1, a short job on engine 2
+        static const uint32_t pool_reach[] = EEPROM_POOL_REACH;
+        eeprom_job_t batch[5];
+        uint64_t done_us[EEPROM_POOL_MAX_ENGINES];
+        for (int steal = 0; steal <= 1; steal++) {
+            batch[0] = (eeprom_job_t){ .chip = jobs[0].chip, .start_addr = 0x3A0, .buf = pool_buf, .len = 16 };
+            batch[1] = (eeprom_job_t){ .chip = jobs[0].chip, .start_addr = 0x3B0, .buf = pool_buf, .len = 16 };
+            batch[2] = (eeprom_job_t){ .chip = jobs[0].chip, .start_addr = 0x3C0, .buf = pool_buf, .len = 16 };
+            batch[3] = (eeprom_job_t){ .chip = jobs[1].chip, .start_addr = 0x3A0, .buf = pool_buf, .len = 32, .diff = true };
+            batch[4] = (eeprom_job_t){ .chip = jobs[2].chip, .start_addr = 0x3A0, .buf = pool_buf, .len = 8 };
+            for (size_t j = 0; j < count_of(batch); j++) batch[j].engine_mask = pool_reach[batch[j].chip.engine];
+
+            bool ok = eeprom_pool_dispatch(&pool, batch, count_of(batch), steal, done_us);
+            printf("%s%s: engines done at", steal ? "work stealing" : "static       ", ok ? "" : " (timeout)");
+            for (size_t e = 0; e < pool.n_engines; e++) printf(" %llu", done_us[e]);
+            printf(" us\n");
+        }
+
+        // DO sample point sweep at 2 MHz on the PIO socket, against a 1 MHz reference read.
+        // pio1 takes the pins over from the pio0 engine, which is not used again after this.
+        uint16_t ref[16];
+        for (uint16_t a = 0; a < count_of(ref); a++) ref[a] = eeprom_chip_read(&pool, jobs[2].chip, a);
+        uint32_t bit_clks = clock_get_hz(clk_sys) / (2000 * 1000);
+        puts("\nPIO DO sample point at 2 MHz:");
+        for (uint q = 0; q < 4; q++) {
+            int e = eeprom_pool_add_pio_sampled(&pool, pio1, EEPROM_PIO_SCK_PIN, EEPROM_PIO_DI_PIN, EEPROM_PIO_DO_PIN,
+                                                2000 * 1000, q * bit_clks / 4);
+            if (e < 0) break;
+            eeprom_chip_t chip = eeprom_pool_add_chip(&pool, e, pool_cs[2]);
+            uint errors = 0;
+            for (uint16_t a = 0; a < count_of(ref); a++) errors += eeprom_chip_read(&pool, chip, a) != ref[a];
+            printf("  +%3lu sys clks: %u/%u words wrong\n", q * bit_clks / 4, errors, count_of(ref));
+            pio_sm_set_enabled(pio1, pool.engines[e].sm, false);
+        }
+    }
+    {
+        // Realignment kernel vs. the per-word scalar expression over a full-chip stream
+        static uint8_t realign_raw[2 * 0x400 + 1];
+        static uint16_t realign_a[0x400], realign_b[0x400];
+        uint32_t rs = 0x1234567;
+        for (size_t i = 0; i < sizeof(realign_raw); i++) {
+            rs = rs * 1664525u + 1013904223u;
+            realign_raw[i] = rs >> 24;
+        }
+        uint64_t t0 = time_us_64();
+        eeprom_realign_scalar(realign_raw, realign_a, 0x400);
+        uint64_t t_scalar = time_us_64() - t0;
+        t0 = time_us_64();
+        eeprom_realign(realign_raw, realign_b, 0x400);
+        uint64_t t_swar = time_us_64() - t0;
+        printf("\nRealign 1024 words: scalar %llu us, swar %llu us, %s\n", t_scalar, t_swar,
+               memcmp(realign_a, realign_b, sizeof(realign_a)) ? "MISMATCH" : "match");
+
+        // Full-chip read: everything above the bus time is copy/realign/turnaround overhead
+        uint64_t bus_us = ((16 + 8 + 2 * 0x400 * 8) * 1000000ull) / spi_get_baudrate(spi_default);
+        t0 = time_us_64();
+        for (uint16_t a = 0; a < 0x400; a++) eeprom_read(spi_default, PICO_DEFAULT_SPI_CSN_PIN, a, &realign_a[a]);
+        uint64_t t_words = time_us_64() - t0;
+        t0 = time_us_64();
+        eeprom_sequential_read_length(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0, realign_b, 0x400);
+        uint64_t t_stream = time_us_64() - t0;
+        t0 = time_us_64();
+        eeprom_read_bulk(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0, realign_b, 0x400);
+        uint64_t t_dma = time_us_64() - t0;
+        printf("Read 1024 words (bus %llu us): per-word %llu us, stream %llu us (+%lld), dma %llu us (+%lld)\n",
+               bus_us, t_words, t_stream, (int64_t)(t_stream - bus_us), t_dma, (int64_t)(t_dma - bus_us));
+
+        // Blank check: a blank part should cost about the bulk read, a programmed one next to nothing
+        uint16_t dirty = 0;
+        t0 = time_us_64();
+        bool blank = eeprom_is_blank(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0, 0x400, &dirty);
+        uint64_t t_blank = time_us_64() - t0;
+        printf("Blank check 1024 words: %s", blank ? "blank" : "not blank");
+        if (!blank) printf(" (first word 0x%03X)", dirty);
+        printf(", %llu us\n", t_blank);
+
+        // Voted read: twice the bus time on a clean bus, disagreements step the clock down
+        t0 = time_us_64();
+        int voted = eeprom_read_voted(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0, realign_b, 0x400, 2);
+        uint64_t t_voted = time_us_64() - t0;
+        printf("Voted read 1024 words: %llu us, %d chunks voted, %lu corrected words, %lu step-downs (now %u Hz)\n",
+               t_voted, voted, eeprom_vote_stats.corrected, eeprom_vote_stats.step_downs, spi_get_baudrate(spi_default));
+
+        // Pattern search for the 0xF1C2 marker that WRITE puts at 0x220, low byte ignored
+        static const uint16_t magic[] = {0xF100};
+        uint16_t hits[8];
+        t0 = time_us_64();
+        size_t n_hits = eeprom_find(spi_default, PICO_DEFAULT_SPI_CSN_PIN, magic, count_of(magic), 0xFF00, hits, count_of(hits));
+        uint64_t t_find = time_us_64() - t0;
+        printf("Find 0xF1xx: %u matches in %llu us", n_hits, t_find);
+        for (size_t i = 0; i < MIN(n_hits, count_of(hits)); i++) printf(" 0x%03X", hits[i]);
+        printf("\n");
+    }
+    #endif
+
+    #ifdef EEPROM_FAULT_INJECT
+    /**
+     * Recovery benchmark: each fault is enabled on its own and the cost of getting the data back
+     * through eeprom_write_verified() / eeprom_wait_ready() is reported.
+     */
+    {
+        const uint16_t fi_addr = 0x3F0;
+        uint32_t fi_ok;
+        uint64_t fi_t0;
+
+        puts("\nFault injection:");
+        eeprom_faults = (eeprom_fault_t){ .read_flip_mask = 0x0100, .read_flip_every = 3 };
+        fi_t0 = time_us_64();
+        fi_ok = 0;
+        for (int i = 0; i < 8; i++) fi_ok += eeprom_write_verified(spi_default, PICO_DEFAULT_SPI_CSN_PIN, fi_addr + i, 0xA500 + i, 3);
+        printf("bit flip on read:   %lu/8 ok, %lu flips, %lu retries, %llu us\n",
+               fi_ok, eeprom_faults.flips_injected, eeprom_faults.retries, time_us_64() - fi_t0);
+
+        eeprom_faults = (eeprom_fault_t){ .lost_write_every = 4 };
+        fi_t0 = time_us_64();
+        fi_ok = 0;
+        for (int i = 0; i < 8; i++) fi_ok += eeprom_write_verified(spi_default, PICO_DEFAULT_SPI_CSN_PIN, fi_addr + i, 0x5A00 + i, 3);
+        printf("write lost to EWDS: %lu/8 ok, %lu lost, %lu retries, %llu us\n",
+               fi_ok, eeprom_faults.writes_lost, eeprom_faults.retries, time_us_64() - fi_t0);
+
+        eeprom_faults = (eeprom_fault_t){ .program_extra_us = 8000 }; // Past the typical tWP, within tWP max
+        fi_t0 = time_us_64();
+        fi_ok = 0;
+        for (int i = 0; i < 8; i++) fi_ok += eeprom_write_verified(spi_default, PICO_DEFAULT_SPI_CSN_PIN, fi_addr + i, 0xC300 + i, 3);
+        printf("slow program cycle: %lu/8 ok, %lu timeouts, %llu us\n", fi_ok, eeprom_faults.busy_timeouts, time_us_64() - fi_t0);
+
+        eeprom_faults = (eeprom_fault_t){ .busy_stuck = true };
+        fi_t0 = time_us_64();
+        fi_ok = eeprom_write_verified(spi_default, PICO_DEFAULT_SPI_CSN_PIN, fi_addr, 0x3C00, 1);
+        printf("stuck busy:         ok=%lu, %lu timeouts, %lu retries, %llu us\n",
+               fi_ok, eeprom_faults.busy_timeouts, eeprom_faults.retries, time_us_64() - fi_t0);
+
+        uint16_t fi_buf[8];
+        uint16_t fi_read;
+        for (int i = 0; i < 8; i++) fi_buf[i] = 0x7700 + i;
+        eeprom_faults = (eeprom_fault_t){ .torn_after_words = 5, .power_loss_mask = 0x00FF };
+        eeprom_write_buf(spi_default, PICO_DEFAULT_SPI_CSN_PIN, fi_addr, fi_buf, 8);
+        fi_ok = 0;
+        for (int i = 0; i < 8; i++) {
+            eeprom_read(spi_default, PICO_DEFAULT_SPI_CSN_PIN, fi_addr + i, &fi_read);
+            fi_ok += (fi_read == fi_buf[i]);
+        }
+        printf("torn update:        %lu/8 words intact after %lu torn update(s)\n", fi_ok, eeprom_faults.torn_updates);
+
+        eeprom_faults = (eeprom_fault_t){0};
+        eeprom_write_enable(spi_default, PICO_DEFAULT_SPI_CSN_PIN);
+    }
+    #endif
+
     // eeprom_dump(spi_default, PICO_DEFAULT_SPI_CSN_PIN);
+    #if defined(BENCH) && defined(EEPROM_LOW_MEM)
+    {
+        // Peak stack (all of their RAM) of the chunked whole-part operations. Only meaningful without the
+        // full-part save_buffer below, which alone is as large as the default 2 KiB core 0 stack
+        static const uint16_t lowmem_ref[0x40] = { [0 ... 0x3F] = 0x5AA5 }; // In flash
+        uint32_t sum = 0;
+        uint32_t *top;
+
+        puts("\nLow-memory operations, peak stack:");
+        top = stack_paint();
+        eeprom_copy_chunked(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0, 0x400, lowmem_sum_sink, &sum);
+        printf("copy       %4u bytes\n", stack_peak(top));
+        top = stack_paint();
+        uint16_t crc = eeprom_crc16(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0, 0x400);
+        printf("crc16      %4u bytes (0x%04X)\n", stack_peak(top), crc);
+        top = stack_paint();
+        int pasted = eeprom_update_buf(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x3C0, lowmem_ref, count_of(lowmem_ref));
+        printf("diff-paste %4u bytes (%d words programmed)\n", stack_peak(top), pasted);
+        top = stack_paint();
+        int bad = eeprom_verify_chunked(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x3C0, lowmem_ref, count_of(lowmem_ref));
+        printf("verify     %4u bytes (%s)\n", stack_peak(top), bad < 0 ? "match" : "MISMATCH");
+        top = stack_paint();
+        int changed = eeprom_transform_chunked(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0x3C0, count_of(lowmem_ref), lowmem_double, NULL);
+        printf("transform  %4u bytes (%d words programmed)\n", stack_peak(top), changed);
+    }
+    #endif
+
+    #ifdef EEPROM_LOW_MEM
+    eeprom_copy_chunked(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0, eeprom_geom->words, lowmem_print_sink, NULL);
+    eeprom_transform_chunked(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0, eeprom_geom->words, lowmem_double, NULL);
+    eeprom_copy_chunked(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0, eeprom_geom->words, lowmem_print_sink, NULL);
+    #else
     // uint16_t save_buffer[0x3FF];
     uint16_t save_buffer[0x400];
     eeprom_copy(spi_default, PICO_DEFAULT_SPI_CSN_PIN, save_buffer);
@@ -577,8 +3320,22 @@ int main() {
     print_buffer(save_buffer);
     // eeprom_paste(spi_default, PICO_DEFAULT_SPI_CSN_PIN, save_buffer);
     eeprom_write_buf(spi_default, PICO_DEFAULT_SPI_CSN_PIN, 0, save_buffer, 1024);
+    #endif
     eeprom_dump(spi_default, PICO_DEFAULT_SPI_CSN_PIN);
 
+    #ifdef EEPROM_WEAR_TRACK
+    {
+        eeprom_wear_entry_t hot[8];
+        int flushed = eeprom_wear_flush(spi_default, PICO_DEFAULT_SPI_CSN_PIN);
+        size_t n_hot = eeprom_wear_hottest(hot, count_of(hot));
+        printf("\nWear counters flushed (%d words programmed), hottest blocks:\n", flushed);
+        for (size_t i = 0; i < n_hot; i++) {
+            printf("  0x%03X-0x%03X: %lu cycles (%lu.%02lu%% of 1M)\n", hot[i].addr, hot[i].addr + EEPROM_WEAR_BLOCK_WORDS - 1,
+                   hot[i].writes, hot[i].writes / 10000, (hot[i].writes / 100) % 100);
+        }
+    }
+    #endif
+
     while (1) {
         sleep_ms(1000);
         tight_loop_contents();